@@ -0,0 +1,316 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "generate.h"
+
+// bench [--compiler=build/compiler] [--baseline=bench/baseline.json]
+//       [--out=build/bench.json] [--repeat=3] [--tolerance=0.4] [--save-baseline]
+//
+// Compiles series of generated programs, each growing one parameter, and
+// reports the time of each phase (from -ftime-trace), tokens/s, lines/s and
+// peak RSS (from -fmem-report). For every series the growth of compile time
+// with input size is fitted as an exponent; one that has risen by more than
+// the tolerance over the baseline's is reported as a complexity regression.
+// Exponents rather than times are compared, so the baseline carries over
+// between machines.
+
+extern char **environ;
+
+struct Case {
+ std::string dimension;
+ int size;
+ GenParams params;
+};
+
+struct Result {
+ std::string name, dimension;
+ int size;
+ size_t lines, tokens, peak_rss;
+ double ms;
+ std::map<std::string, double> phases;
+};
+
+struct Series {
+ std::string dimension;
+ double exponent;
+ std::map<std::string, double> phases;
+};
+
+static const char *phase_names[] = {
+ "Lexer", "CParser", "Parse", "ResolveIdents", "Typecheck", "TACKYifier", "Generator", "Emitter"
+};
+
+static const char *top_level[] = {"Read source", "Lexer", "CParser", "TACKYifier", "Generator", "Emitter", "Write output"};
+
+static std::vector<Case> make_cases() {
+ struct Dimension {
+  const char *name;
+  int GenParams::*param;
+  int start;
+ };
+
+ Dimension dimensions[] = {
+  {"functions", &GenParams::functions, 25},
+  {"depth", &GenParams::depth, 8},
+  {"expr_length", &GenParams::expr_length, 16},
+  {"switch_cases", &GenParams::switch_cases, 32},
+  {"globals", &GenParams::globals, 200},
+  {"nesting", &GenParams::nesting, 64},
+ };
+
+ std::vector<Case> cases;
+ for (Dimension &dimension : dimensions) {
+  for (int scale = 1; scale <= 8; scale *= 2) {
+   GenParams params;
+   params.*dimension.param = dimension.start * scale;
+   cases.push_back({dimension.name, dimension.start * scale, params});
+  }
+ }
+
+ return cases;
+}
+
+static bool run(std::vector<std::string> args) {
+ std::vector<char *> argv;
+ for (std::string &arg : args) argv.push_back(arg.data());
+ argv.push_back(nullptr);
+
+ pid_t pid;
+ if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return false;
+
+ int status;
+ waitpid(pid, &status, 0);
+ return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// The compiler's reports, and the baseline, have one object per line, so a
+// field is found by its key.
+static std::string field(const std::string &line, const std::string &key) {
+ size_t pos = line.find("\"" + key + "\":");
+ if (pos == std::string::npos) return "";
+
+ pos += key.size() + 3;
+ if (line[pos] == '"') return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+
+ return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+static double number(const std::string &line, const std::string &key) {
+ std::string value = field(line, key);
+ return value == "" ? 0 : strtod(value.c_str(), nullptr);
+}
+
+static std::vector<std::string> read_lines(std::string path) {
+ std::ifstream file(path);
+ std::vector<std::string> lines;
+ for (std::string line; std::getline(file, line);) lines.push_back(line);
+ return lines;
+}
+
+static bool measure(std::string compiler, std::string dir, Case &test, int repeat, Result &result) {
+ std::string source = ProgramGenerator(test.params).generate();
+ std::string path = dir + "/" + test.dimension + ".c";
+ std::ofstream(path) << source;
+
+ result.name = test.dimension + "-" + std::to_string(test.size);
+ result.dimension = test.dimension;
+ result.size = test.size;
+ result.lines = std::count(source.begin(), source.end(), '\n');
+ result.ms = INFINITY;
+
+ // The fastest of the runs, to keep out noise from the rest of the machine.
+ for (int i = 0; i < repeat; i++) {
+  std::string trace = dir + "/trace.json";
+  if (!run({compiler, path, "/dev/null", "-ftime-trace=" + trace})) return false;
+
+  double ms = 0;
+  std::map<std::string, double> phases;
+  for (std::string &line : read_lines(trace)) {
+   std::string name = field(line, "name");
+   double dur = number(line, "dur") / 1000;
+   for (const char *phase : top_level) ms += name == phase ? dur : 0;
+   for (const char *phase : phase_names) phases[phase] += name == phase ? dur : 0;
+  }
+
+  if (ms < result.ms) {
+   result.ms = ms;
+   result.phases = phases;
+  }
+ }
+
+ // Memory is measured on its own run, as counting allocations slows it.
+ std::string mem = dir + "/mem.json";
+ if (!run({compiler, path, "/dev/null", "-fmem-report=" + mem})) return false;
+
+ result.peak_rss = result.tokens = 0;
+ for (std::string &line : read_lines(mem)) {
+  result.peak_rss = std::max(result.peak_rss, (size_t)number(line, "peak_rss"));
+  if (field(line, "name") == "Token vector") result.tokens = number(line, "count");
+ }
+
+ return true;
+}
+
+// Least-squares slope of log(time) against log(tokens).
+static double fit_exponent(std::vector<Result *> &results, std::string phase) {
+ double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+ for (Result *result : results) {
+  double time = phase == "" ? result->ms : result->phases[phase];
+  if (time <= 0 || result->tokens == 0) continue;
+
+  double x = std::log((double)result->tokens), y = std::log(time);
+  n++;
+  sx += x;
+  sy += y;
+  sxx += x * x;
+  sxy += x * y;
+ }
+
+ double denom = n * sxx - sx * sx;
+ return n < 2 || denom == 0 ? 0 : (n * sxy - sx * sy) / denom;
+}
+
+static std::string phases_json(std::map<std::string, double> &phases) {
+ std::ostringstream out;
+ out << "{";
+ for (auto it = phases.begin(); it != phases.end(); it++) {
+  out << (it == phases.begin() ? "" : ",") << "\"" << it->first << "\":" << it->second;
+ }
+
+ out << "}";
+ return out.str();
+}
+
+static void write_json(std::string path, std::vector<Result> &results, std::vector<Series> &series) {
+ std::ofstream out(path);
+ out << "{\"cases\":[";
+ for (size_t i = 0; i < results.size(); i++) {
+  Result &result = results[i];
+  out << (i ? "," : "") << "\n{\"name\":\"" << result.name << "\",\"dimension\":\"" << result.dimension
+      << "\",\"size\":" << result.size << ",\"lines\":" << result.lines << ",\"tokens\":" << result.tokens
+      << ",\"ms\":" << result.ms << ",\"tokens_per_s\":" << result.tokens / result.ms * 1000
+      << ",\"lines_per_s\":" << result.lines / result.ms * 1000 << ",\"peak_rss\":" << result.peak_rss
+      << ",\"phases\":" << phases_json(result.phases) << "}";
+ }
+
+ out << "],\"series\":[";
+ for (size_t i = 0; i < series.size(); i++) {
+  out << (i ? "," : "") << "\n{\"dimension\":\"" << series[i].dimension << "\",\"exponent\":" << series[i].exponent
+      << ",\"phases\":" << phases_json(series[i].phases) << "}";
+ }
+
+ out << "]}\n";
+}
+
+int main(int argc, char *argv[]) {
+ std::string compiler = "build/compiler", baseline = "bench/baseline.json", out = "build/bench.json";
+ int repeat = 3;
+ double tolerance = 0.4;
+ bool save_baseline = false;
+
+ for (int i = 1; i < argc; i++) {
+  std::string arg = argv[i];
+  std::string value = arg.substr(arg.find('=') + 1);
+
+  if (arg.substr(0, 11) == "--compiler=") compiler = value;
+  else if (arg.substr(0, 11) == "--baseline=") baseline = value;
+  else if (arg.substr(0, 6) == "--out=") out = value;
+  else if (arg.substr(0, 9) == "--repeat=") repeat = std::max(1, atoi(value.c_str()));
+  else if (arg.substr(0, 12) == "--tolerance=") tolerance = strtod(value.c_str(), nullptr);
+  else if (arg == "--save-baseline") save_baseline = true;
+  else {
+   std::cerr << "Unknown option " << arg << '\n';
+   return 1;
+  }
+ }
+
+ char dir_template[] = "/tmp/c-bench-XXXXXX";
+ if (mkdtemp(dir_template) == nullptr) {
+  std::cerr << "Could not create a temporary directory\n";
+  return 1;
+ }
+
+ std::string dir = dir_template;
+ std::vector<Case> cases = make_cases();
+ std::vector<Result> results(cases.size());
+
+ printf("%-20s %8s %9s %10s %12s %12s %10s\n", "Case", "Lines", "Tokens", "ms", "Tokens/s", "Lines/s", "Peak RSS");
+ for (size_t i = 0; i < cases.size(); i++) {
+  Result &result = results[i];
+  if (!measure(compiler, dir, cases[i], repeat, result)) {
+   std::cerr << "Compiling " << cases[i].dimension << "-" << cases[i].size << " failed (inputs kept in " << dir << ")\n";
+   return 1;
+  }
+
+  printf(
+   "%-20s %8zu %9zu %10.2f %12.0f %12.0f %7zu MiB\n",
+   result.name.c_str(), result.lines, result.tokens, result.ms,
+   result.tokens / result.ms * 1000, result.lines / result.ms * 1000, result.peak_rss >> 20
+  );
+ }
+
+ std::vector<Series> series;
+ for (size_t i = 0; i < results.size();) {
+  std::vector<Result *> points;
+  for (size_t j = i; j < results.size() && results[j].dimension == results[i].dimension; j++) points.push_back(&results[j]);
+
+  // Phases too small to matter at the largest size only add noise.
+  Series fit = {results[i].dimension, fit_exponent(points, ""), {}};
+  for (const char *phase : phase_names) {
+   if (points.back()->phases[phase] >= points.back()->ms / 20) fit.phases[phase] = fit_exponent(points, phase);
+  }
+  series.push_back(fit);
+  i += points.size();
+ }
+
+ write_json(out, results, series);
+ if (save_baseline) write_json(baseline, results, series);
+ system(("rm -rf " + dir).c_str());
+
+ std::map<std::string, std::string> expected;
+ for (std::string &line : read_lines(baseline)) {
+  if (field(line, "exponent") != "") expected[field(line, "dimension")] = line;
+ }
+
+ // The phase with the largest rise is named, as that is where to look.
+ int regressions = 0;
+ printf("\n%-20s %10s %10s\n", "Series", "Exponent", "Baseline");
+ for (Series &fit : series) {
+  auto it = expected.find(fit.dimension);
+  if (it == expected.end()) {
+   printf("%-20s %10.2f %10s\n", fit.dimension.c_str(), fit.exponent, "-");
+   continue;
+  }
+
+  double base = number(it->second, "exponent");
+  std::string worst;
+  double worst_rise = 0;
+  for (auto &[phase, exponent] : fit.phases) {
+   if (field(it->second, phase) == "") continue;
+
+   double rise = exponent - number(it->second, phase);
+   if (rise > worst_rise) {
+    worst = phase;
+    worst_rise = rise;
+   }
+  }
+
+  bool regressed = fit.exponent > base + tolerance;
+  regressions += regressed;
+  printf("%-20s %10.2f %10.2f", fit.dimension.c_str(), fit.exponent, base);
+  if (regressed) printf("   regression (%s: +%.2f)", worst.c_str(), worst_rise);
+  printf("\n");
+ }
+
+ printf("\nResults written to %s\n", out.c_str());
+ return regressions ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <cstdlib>
+#include "generate.h"
+
+// generate [--functions=N] [--depth=N] [--expr-length=N] [--switch-cases=N]
+//          [--globals=N] [--nesting=N] [--seed=N]
+// Writes a synthetic C program to stdout.
+int main(int argc, char *argv[]) {
+ GenParams params;
+
+ for (int i = 1; i < argc; i++) {
+  std::string arg = argv[i];
+  size_t eq = arg.find('=');
+  std::string name = arg.substr(0, eq);
+  long value = eq == std::string::npos ? 0 : strtol(arg.c_str() + eq + 1, nullptr, 10);
+
+  if (name == "--functions") params.functions = value;
+  else if (name == "--depth") params.depth = value;
+  else if (name == "--expr-length") params.expr_length = value;
+  else if (name == "--switch-cases") params.switch_cases = value;
+  else if (name == "--globals") params.globals = value;
+  else if (name == "--nesting") params.nesting = value;
+  else if (name == "--seed") params.seed = value;
+  else {
+   std::cerr << "Unknown option " << arg << '\n';
+   return 1;
+  }
+ }
+
+ if (params.functions < 1) {
+  std::cerr << "--functions must be at least 1\n";
+  return 1;
+ }
+
+ std::cout << ProgramGenerator(params).generate();
+ return 0;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Synthetic C programs for the throughput benchmark, using only what the
+// compiler supports. Every parameter scales one part of the input so that a
+// series over it shows how that part of the compiler grows.
+struct GenParams {
+ int functions = 20;
+ // Nesting of if/while/for/do statements in each function.
+ int depth = 4;
+ // Binary operators per expression.
+ int expr_length = 8;
+ int switch_cases = 8;
+ int globals = 16;
+ // Nested blocks that each declare a shadowing local.
+ int nesting = 4;
+ uint64_t seed = 1;
+};
+
+class ProgramGenerator {
+ private:
+  GenParams params;
+  std::string out;
+  uint64_t state;
+  int func;
+
+  int random(int n) {
+   state = state * 6364136223846793005ull + 1442695040888963407ull;
+   return (int)((state >> 33) % (uint64_t)n);
+  }
+
+  void indent(int level) {
+   out.append(level, ' ');
+  }
+
+  // Initialisers leave out x, which is not set yet there.
+  std::string operand(bool use_x) {
+   switch (random(6)) {
+    case 0: return "a";
+    case 1: return "b";
+    case 2: return use_x ? "x" : "b";
+    case 3: return params.globals ? "g" + std::to_string(random(params.globals)) : "a";
+    default: return std::to_string(random(100));
+   }
+  }
+
+  // Division is left out so that no input can trap.
+  std::string expr(int length, bool use_x = true) {
+   static const char *ops[] = {" + ", " - ", " * ", " & ", " | ", " ^ ", " < ", " == "};
+   std::string result = operand(use_x);
+   for (int i = 0; i < length; i++) {
+    if (random(4) == 0) result = "(" + result + ")";
+    result += ops[random(8)] + operand(use_x);
+   }
+
+   return result;
+  }
+
+  // One nested statement per level keeps the size linear in the depth.
+  void statement(int depth, int level) {
+   if (depth == 0) {
+    indent(level);
+    out += "x = " + expr(params.expr_length) + ";\n";
+    return;
+   }
+
+   std::string counter = "i" + std::to_string(depth);
+   indent(level);
+   switch (random(4)) {
+    case 0:
+     out += "if (" + expr(2) + ") {\n";
+     statement(depth - 1, level + 1);
+     indent(level);
+     out += "} else {\n";
+     indent(level + 1);
+     out += "x = x + 1;\n";
+     break;
+    case 1:
+     out += "for (int " + counter + " = 0; " + counter + " < 3; " + counter + " = " + counter + " + 1) {\n";
+     statement(depth - 1, level + 1);
+     break;
+    case 2:
+     out += "int " + counter + " = 0;\n";
+     indent(level);
+     out += "while (" + counter + " < 2) {\n";
+     indent(level + 1);
+     out += counter + " = " + counter + " + 1;\n";
+     statement(depth - 1, level + 1);
+     break;
+    default:
+     out += "{\n";
+     indent(level + 1);
+     out += "int " + counter + " = 0;\n";
+     indent(level + 1);
+     out += "do {\n";
+     statement(depth - 1, level + 2);
+     indent(level + 2);
+     out += counter + " = " + counter + " + 1;\n";
+     indent(level + 1);
+     out += "} while (" + counter + " < 2);\n";
+     break;
+   }
+
+   indent(level);
+   out += "}\n";
+  }
+
+  void switch_statement() {
+   out += " switch (a & " + std::to_string(params.switch_cases * 2) + ") {\n";
+   for (int i = 0; i < params.switch_cases; i++) {
+    out += "  case " + std::to_string(i) + ":\n";
+    out += "   x = " + expr(2) + ";\n";
+    if (random(3) != 0) out += "   break;\n";
+   }
+
+   out += "  default:\n   x = x - 1;\n }\n";
+  }
+
+  void nested_blocks() {
+   for (int i = 0; i < params.nesting; i++) {
+    indent(i + 1);
+    out += "{\n";
+    indent(i + 2);
+    out += "int x = " + expr(1, false) + ";\n";
+   }
+
+   indent(params.nesting + 1);
+   out += "b = b + x;\n";
+   for (int i = params.nesting; i > 0; i--) {
+    indent(i);
+    out += "}\n";
+   }
+  }
+
+  void function() {
+   std::string name = "f" + std::to_string(func);
+   out += (random(4) == 0 ? "static int " : "int ") + name + "(int a, int b) {\n";
+   out += " int x = " + expr(params.expr_length, false) + ";\n";
+   statement(params.depth, 1);
+   switch_statement();
+   nested_blocks();
+   if (params.globals) {
+    std::string global = "g" + std::to_string(func % params.globals);
+    out += " " + global + " = " + global + " + x;\n";
+   }
+
+   // Each function calls the one before it, so none is dead.
+   out += " return x + b" + (func ? " + f" + std::to_string(func - 1) + "(a, x)" : std::string()) + ";\n}\n\n";
+  }
+
+ public:
+  ProgramGenerator(GenParams params) : params(params), state(params.seed), func(0) {}
+
+  std::string generate() {
+   for (int i = 0; i < params.globals; i++) {
+    out += (i % 3 == 0 ? "static int g" : "int g") + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+   }
+
+   out += "\n";
+   for (func = 0; func < params.functions; func++) function();
+
+   out += "int main(void) {\n return f" + std::to_string(params.functions - 1) + "(1, 2) & 255;\n}\n";
+   return out;
+  }
+};
@@ -0,0 +1,18 @@
+// Recursive calls: call overhead, argument moves and the stack frame.
+int putchar(int c);
+
+int print_num(unsigned long n) {
+ if (n >= 10) print_num(n / 10);
+ return putchar(48 + (int)(n % 10));
+}
+
+int fib(int n) {
+ if (n < 2) return n;
+ return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+ print_num(fib(35));
+ putchar(10);
+ return 0;
+}
@@ -0,0 +1,29 @@
+// Euclid's algorithm in a loop: division and remainder dominate.
+int putchar(int c);
+
+int print_num(unsigned long n) {
+ if (n >= 10) print_num(n / 10);
+ return putchar(48 + (int)(n % 10));
+}
+
+long gcd(long a, long b) {
+ while (b != 0) {
+  long t = a % b;
+  a = b;
+  b = t;
+ }
+ return a;
+}
+
+int main(void) {
+ unsigned long sum = 0;
+ for (long i = 1; i <= 2000; i = i + 1) {
+  for (long j = 1; j <= 1000; j = j + 1) {
+   sum = sum + gcd(i * 7919, j * 104729);
+  }
+ }
+
+ print_num(sum);
+ putchar(10);
+ return 0;
+}
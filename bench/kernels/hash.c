@@ -0,0 +1,37 @@
+// FNV-1a and a 64-bit finaliser: multiplies, xors and shifts on unsigned
+// long, with a static accumulator.
+int putchar(int c);
+
+static unsigned long checksum = 0;
+
+int print_num(unsigned long n) {
+ if (n >= 10) print_num(n / 10);
+ return putchar(48 + (int)(n % 10));
+}
+
+unsigned long mix(unsigned long h) {
+ h = h ^ (h >> 33);
+ h = h * 18397679294719823053ul;
+ h = h ^ (h >> 33);
+ h = h * 14181476777654086739ul;
+ return h ^ (h >> 33);
+}
+
+unsigned long fnv(unsigned long value) {
+ unsigned long h = 14695981039346656037ul;
+ for (int i = 0; i < 8; i = i + 1) {
+  h = (h ^ (value & 255)) * 1099511628211ul;
+  value = value >> 8;
+ }
+ return h;
+}
+
+int main(void) {
+ for (unsigned long i = 0; i < 3000000; i = i + 1) {
+  checksum = checksum + mix(fnv(i) ^ checksum);
+ }
+
+ print_num(checksum);
+ putchar(10);
+ return 0;
+}
@@ -0,0 +1,36 @@
+// Counted loops with loop-invariant arithmetic and a Collatz inner loop.
+int putchar(int c);
+
+int print_num(unsigned long n) {
+ if (n >= 10) print_num(n / 10);
+ return putchar(48 + (int)(n % 10));
+}
+
+long collatz(long n) {
+ long steps = 0;
+ while (n != 1) {
+  if (n % 2 == 0) n = n / 2;
+  else n = 3 * n + 1;
+  steps = steps + 1;
+ }
+ return steps;
+}
+
+int main(void) {
+ long total = 0;
+ int scale = 7;
+
+ for (long i = 1; i < 300000; i = i + 1) {
+  total = total + collatz(i);
+ }
+
+ for (int i = 0; i < 3000; i = i + 1) {
+  for (int j = 0; j < 3000; j = j + 1) {
+   total = total + (i * scale + j) % 13;
+  }
+ }
+
+ print_num(total);
+ putchar(10);
+ return 0;
+}
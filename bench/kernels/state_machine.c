@@ -0,0 +1,60 @@
+// A switch-driven tokenizer over pseudo-random input: branchy code with
+// unpredictable jumps.
+int putchar(int c);
+
+int print_num(unsigned long n) {
+ if (n >= 10) print_num(n / 10);
+ return putchar(48 + (int)(n % 10));
+}
+
+static unsigned seed = 12345;
+
+int next_char(void) {
+ seed = seed * 1103515245u + 12345u;
+ return (int)((seed >> 16) % 8);
+}
+
+int main(void) {
+ int state = 0;
+ unsigned long words = 0;
+ unsigned long numbers = 0;
+ unsigned long symbols = 0;
+ unsigned long length = 0;
+
+ for (int i = 0; i < 20000000; i = i + 1) {
+  int c = next_char();
+
+  switch (state) {
+   case 0:
+    switch (c) {
+     case 0: case 1: case 2: state = 1; length = 1; break;
+     case 3: case 4: state = 2; length = 1; break;
+     case 5: symbols = symbols + 1; break;
+     default: break;
+    }
+    break;
+   case 1:
+    if (c <= 3) length = length + 1;
+    else {
+     words = words + length;
+     state = c == 5 ? 3 : 0;
+    }
+    break;
+   case 2:
+    switch (c) {
+     case 3: case 4: case 6: length = length + 1; break;
+     case 7: state = 3; break;
+     default: numbers = numbers + length; state = 0;
+    }
+    break;
+   default:
+    symbols = symbols + c;
+    state = c & 1;
+    length = 1;
+  }
+ }
+
+ print_num(words * 3 + numbers * 5 + symbols * 7);
+ putchar(10);
+ return 0;
+}
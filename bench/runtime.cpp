@@ -0,0 +1,275 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// runtime [--driver=build/compiler_driver] [--kernels=bench/kernels]
+//         [--cc-flags="..."] [--repeat=5] [--warmup=1] [--out=build/runtime.json]
+//         [--baseline=bench/runtime_baseline.json] [--save-baseline]
+//
+// Builds every kernel with this compiler and with gcc -O0 and -O2, checks
+// that the three print the same thing, and times them: the median of
+// --repeat runs after --warmup discarded ones, in cycles where
+// perf_event_open is allowed and in milliseconds otherwise. The ratios to gcc
+// are compared against the baseline's, which makes them usable across
+// machines for following the optimiser.
+
+extern char **environ;
+
+struct Build {
+ const char *name;
+ std::string binary;
+ double ms;
+ int64_t cycles;
+ std::string output;
+};
+
+struct Kernel {
+ std::string name;
+ Build builds[3];
+};
+
+static std::string read_fd(int fd) {
+ std::string out;
+ char buf[4096];
+ for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) out.append(buf, n);
+ return out;
+}
+
+static bool run(std::vector<std::string> args, std::string *output = nullptr) {
+ std::vector<char *> argv;
+ for (std::string &arg : args) argv.push_back(arg.data());
+ argv.push_back(nullptr);
+
+ int fds[2] = {-1, -1};
+ posix_spawn_file_actions_t actions;
+ posix_spawn_file_actions_init(&actions);
+ if (output && pipe(fds) == 0) {
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+ }
+
+ pid_t pid;
+ bool spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+ posix_spawn_file_actions_destroy(&actions);
+ if (fds[1] != -1) close(fds[1]);
+ if (output && fds[0] != -1) {
+  *output = spawned ? read_fd(fds[0]) : "";
+  close(fds[0]);
+ }
+
+ int status = 0;
+ if (spawned) waitpid(pid, &status, 0);
+ return spawned && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Counts the cycles of this process and of the children it starts after
+// this; a child's count is added in when it is waited for.
+static int open_cycles() {
+ perf_event_attr attr;
+ memset(&attr, 0, sizeof(attr));
+ attr.size = sizeof(attr);
+ attr.type = PERF_TYPE_HARDWARE;
+ attr.config = PERF_COUNT_HW_CPU_CYCLES;
+ attr.disabled = 1;
+ attr.inherit = 1;
+ attr.exclude_kernel = 1;
+ attr.exclude_hv = 1;
+
+ return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static bool time_binary(Build &build, int counter, int repeat, int warmup) {
+ std::vector<double> times;
+ std::vector<int64_t> cycles;
+
+ for (int i = 0; i < warmup + repeat; i++) {
+  std::string output;
+  int64_t count = 0;
+  if (counter != -1) {
+   ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+   ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  bool ok = run({build.binary}, &output);
+  auto end = std::chrono::steady_clock::now();
+
+  if (counter != -1) {
+   ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+   if (read(counter, &count, sizeof(count)) != sizeof(count)) count = -1;
+  }
+
+  if (!ok) return false;
+  build.output = output;
+  if (i < warmup) continue;
+
+  times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  cycles.push_back(counter == -1 ? -1 : count);
+ }
+
+ std::sort(times.begin(), times.end());
+ std::sort(cycles.begin(), cycles.end());
+ build.ms = times[times.size() / 2];
+ build.cycles = cycles[cycles.size() / 2];
+ return true;
+}
+
+static std::vector<std::string> list_kernels(std::string dir) {
+ std::vector<std::string> names;
+ if (DIR *kernels = opendir(dir.c_str())) {
+  while (dirent *entry = readdir(kernels)) {
+   std::string name = entry->d_name;
+   if (name.size() > 2 && name.substr(name.size() - 2) == ".c") names.push_back(name.substr(0, name.size() - 2));
+  }
+
+  closedir(kernels);
+ }
+
+ std::sort(names.begin(), names.end());
+ return names;
+}
+
+// The baseline has one kernel per line, so a field is found by its key.
+static double number(const std::string &line, const std::string &key) {
+ size_t pos = line.find("\"" + key + "\":");
+ return pos == std::string::npos ? 0 : strtod(line.c_str() + pos + key.size() + 3, nullptr);
+}
+
+static std::string name_field(const std::string &line) {
+ size_t pos = line.find("\"name\":\"");
+ if (pos == std::string::npos) return "";
+
+ pos += 8;
+ return line.substr(pos, line.find('"', pos) - pos);
+}
+
+int main(int argc, char *argv[]) {
+ std::string driver = "build/compiler_driver", kernel_dir = "bench/kernels", out = "build/runtime.json";
+ std::string baseline = "bench/runtime_baseline.json";
+ std::vector<std::string> cc_flags;
+ int repeat = 5, warmup = 1;
+ bool save_baseline = false;
+
+ for (int i = 1; i < argc; i++) {
+  std::string arg = argv[i];
+  std::string value = arg.substr(arg.find('=') + 1);
+
+  if (arg.substr(0, 9) == "--driver=") driver = value;
+  else if (arg.substr(0, 10) == "--kernels=") kernel_dir = value;
+  else if (arg.substr(0, 11) == "--cc-flags=") {
+   for (size_t start = 0, end; start < value.size(); start = end + 1) {
+    end = value.find(' ', start);
+    if (end == std::string::npos) end = value.size();
+    if (end > start) cc_flags.push_back(value.substr(start, end - start));
+   }
+  } else if (arg.substr(0, 9) == "--repeat=") repeat = std::max(1, atoi(value.c_str()));
+  else if (arg.substr(0, 9) == "--warmup=") warmup = std::max(0, atoi(value.c_str()));
+  else if (arg.substr(0, 6) == "--out=") out = value;
+  else if (arg.substr(0, 11) == "--baseline=") baseline = value;
+  else if (arg == "--save-baseline") save_baseline = true;
+  else {
+   std::cerr << "Unknown option " << arg << '\n';
+   return 1;
+  }
+ }
+
+ char dir_template[] = "/tmp/c-runtime-XXXXXX";
+ if (mkdtemp(dir_template) == nullptr) {
+  std::cerr << "Could not create a temporary directory\n";
+  return 1;
+ }
+
+ std::string dir = dir_template;
+ int counter = open_cycles();
+ const char *unit = counter == -1 ? "ms" : "Mcycles";
+ if (counter == -1) std::cerr << "perf_event_open is unavailable; timing in milliseconds\n";
+
+ std::map<std::string, std::string> expected;
+ {
+  std::ifstream file(baseline);
+  for (std::string line; std::getline(file, line);) {
+   if (name_field(line) != "") expected[name_field(line)] = line;
+  }
+ }
+
+ std::vector<Kernel> kernels;
+ int failures = 0;
+ printf("%-16s %12s %12s %12s %9s %9s %9s\n", "Kernel", ("ours " + std::string(unit)).c_str(), "gcc -O0", "gcc -O2", "/ -O0", "/ -O2", "baseline");
+ for (std::string &name : list_kernels(kernel_dir)) {
+  std::string source = kernel_dir + "/" + name + ".c";
+  Kernel kernel = {name, {{"ours"}, {"gcc -O0"}, {"gcc -O2"}}};
+  for (Build &build : kernel.builds) build.binary = dir + "/" + name + "-" + std::to_string(&build - kernel.builds);
+
+  std::vector<std::string> ours = {driver, source, "-o", kernel.builds[0].binary};
+  ours.insert(ours.end(), cc_flags.begin(), cc_flags.end());
+  bool built = run(ours) &&
+   run({"gcc", "-w", "-O0", source, "-o", kernel.builds[1].binary}) &&
+   run({"gcc", "-w", "-O2", source, "-o", kernel.builds[2].binary});
+
+  bool timed = built;
+  for (Build &build : kernel.builds) timed = timed && time_binary(build, counter, repeat, warmup);
+
+  if (!timed) {
+   printf("%-16s failed to build or run\n", name.c_str());
+   failures++;
+   continue;
+  }
+
+  if (kernel.builds[0].output != kernel.builds[1].output || kernel.builds[0].output != kernel.builds[2].output) {
+   printf("%-16s output differs from gcc\n", name.c_str());
+   failures++;
+   continue;
+  }
+
+  auto cost = [&](Build &build) {return counter == -1 ? build.ms : build.cycles / 1e6;};
+  double ratio_o0 = cost(kernel.builds[0]) / cost(kernel.builds[1]);
+  double ratio_o2 = cost(kernel.builds[0]) / cost(kernel.builds[2]);
+
+  char base[16] = "-";
+  if (expected.count(name)) snprintf(base, sizeof(base), "%.2f", number(expected[name], "ratio_o2"));
+
+  printf(
+   "%-16s %12.2f %12.2f %12.2f %9.2f %9.2f %9s\n",
+   name.c_str(), cost(kernel.builds[0]), cost(kernel.builds[1]), cost(kernel.builds[2]), ratio_o0, ratio_o2, base
+  );
+
+  kernels.push_back(kernel);
+ }
+
+ std::ofstream json(out);
+ json << "{\"unit\":\"" << unit << "\",\"kernels\":[";
+ for (size_t i = 0; i < kernels.size(); i++) {
+  Kernel &kernel = kernels[i];
+  auto cost = [&](Build &build) {return counter == -1 ? build.ms : (double)build.cycles;};
+
+  json << (i ? "," : "") << "\n{\"name\":\"" << kernel.name << "\"";
+  for (Build &build : kernel.builds) {
+   std::string key = build.name == std::string("ours") ? "ours" : build.name == std::string("gcc -O0") ? "gcc_o0" : "gcc_o2";
+   json << ",\"" << key << "_ms\":" << build.ms << ",\"" << key << "_cycles\":" << build.cycles;
+  }
+
+  json << ",\"ratio_o0\":" << cost(kernel.builds[0]) / cost(kernel.builds[1])
+       << ",\"ratio_o2\":" << cost(kernel.builds[0]) / cost(kernel.builds[2]) << "}";
+ }
+ json << "]}\n";
+ json.close();
+
+ if (save_baseline) run({"cp", out, baseline});
+ run({"rm", "-rf", dir});
+
+ printf("\nResults written to %s\n", out.c_str());
+ return failures ? 1 : 0;
+}
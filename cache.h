@@ -0,0 +1,198 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// 128-bit FNV-1a, used to content-address cache entries.
+class Hasher {
+ private:
+  unsigned __int128 state;
+
+ public:
+  Hasher() {
+   state = (unsigned __int128)0x6c62272e07bb0142 << 64 | 0x62b821756295c58d;
+  }
+
+  Hasher &add(const char *data, size_t length) {
+   const unsigned __int128 prime = (unsigned __int128)1 << 88 | 0x13b;
+
+   for (size_t i = 0; i < length; i++) {
+    state ^= (unsigned char)data[i];
+    state *= prime;
+   }
+
+   return *this;
+  }
+
+  // Strings are length-prefixed so that ("ab", "c") and ("a", "bc") differ.
+  Hasher &add(const std::string &str) {
+   uint64_t length = str.size();
+   add((const char *)&length, sizeof(length));
+
+   return add(str.data(), str.size());
+  }
+
+  Hasher &add(uint64_t num) {
+   return add((const char *)&num, sizeof(num));
+  }
+
+  std::string hex() {
+   static const char digits[] = "0123456789abcdef";
+   std::string out(32, '0');
+   unsigned __int128 val = state;
+
+   for (int i = 31; i >= 0; i--, val >>= 4) {
+    out[i] = digits[val & 0xf];
+   }
+
+   return out;
+  }
+};
+
+inline bool read_file(const std::string &path, std::string &contents) {
+ std::ifstream ifs(path, std::ios::in | std::ios::binary);
+ if (!ifs) return false;
+
+ std::stringstream buf;
+ buf << ifs.rdbuf();
+ contents = buf.str();
+
+ return true;
+}
+
+// Identifies a build of the compiler without reading the whole binary:
+// any rebuild changes its size, inode or modification time.
+inline std::string file_fingerprint(const std::string &path) {
+ struct stat st;
+ if (stat(path.c_str(), &st) != 0) return "";
+
+ return Hasher()
+  .add((uint64_t)st.st_size)
+  .add((uint64_t)st.st_ino)
+  .add((uint64_t)st.st_mtim.tv_sec)
+  .add((uint64_t)st.st_mtim.tv_nsec)
+  .hex();
+}
+
+struct CacheStats {
+ uint64_t hits, misses, entries, bytes;
+};
+
+// A directory of immutable entries named "<key>.<ext>". Entries are written
+// to a private temporary file and rename()d into place, so concurrent
+// readers only ever observe complete entries.
+class ContentCache {
+ private:
+  std::string dir;
+
+  std::string stats_path() {return dir + "/stats";}
+
+  void update_stats(uint64_t add_hits, uint64_t add_misses, bool reset) {
+   int fd = open(stats_path().c_str(), O_RDWR | O_CREAT, 0644);
+   if (fd < 0) return;
+
+   flock(fd, LOCK_EX);
+   char buf[128] = {0};
+   unsigned long long hits = 0, misses = 0;
+   if (pread(fd, buf, sizeof(buf) - 1, 0) > 0) {
+    sscanf(buf, "hits %llu\nmisses %llu\n", &hits, &misses);
+   }
+
+   if (reset) hits = misses = 0;
+   hits += add_hits;
+   misses += add_misses;
+
+   int len = snprintf(buf, sizeof(buf), "hits %llu\nmisses %llu\n", hits, misses);
+   if (ftruncate(fd, 0) == 0) pwrite(fd, buf, len, 0);
+   flock(fd, LOCK_UN);
+   close(fd);
+  }
+
+ public:
+  ContentCache() = delete;
+  ContentCache(std::string dir) : dir(dir) {
+   for (size_t i = 1; i <= dir.size(); i++) {
+    if (i == dir.size() || dir[i] == '/') {
+     mkdir(dir.substr(0, i).c_str(), 0755);
+    }
+   }
+  }
+
+  // $C_COMPILER_CACHE, else $XDG_CACHE_HOME/c-compiler, else ~/.cache/c-compiler.
+  static std::string default_dir() {
+   if (const char *env = getenv("C_COMPILER_CACHE"); env && *env) return env;
+   if (const char *env = getenv("XDG_CACHE_HOME"); env && *env) return std::string(env) + "/c-compiler";
+
+   const char *home = getenv("HOME");
+   return std::string(home ? home : ".") + "/.cache/c-compiler";
+  }
+
+  std::string entry_path(const std::string &key, const std::string &ext) {
+   return dir + "/" + key + "." + ext;
+  }
+
+  bool lookup(const std::string &key, const std::string &ext, std::string &contents) {
+   return read_file(entry_path(key, ext), contents);
+  }
+
+  bool store(const std::string &key, const std::string &ext, const std::string &contents) {
+   char tmp_path[4096];
+   snprintf(tmp_path, sizeof(tmp_path), "%s/.tmp.%s.XXXXXX", dir.c_str(), key.c_str());
+
+   int fd = mkstemp(tmp_path);
+   if (fd < 0) return false;
+
+   bool ok = fchmod(fd, 0644) == 0;
+   for (size_t written = 0; ok && written < contents.size();) {
+    ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+    ok = n > 0;
+    written += ok ? n : 0;
+   }
+
+   ok = close(fd) == 0 && ok;
+   ok = ok && rename(tmp_path, entry_path(key, ext).c_str()) == 0;
+   if (!ok) unlink(tmp_path);
+
+   return ok;
+  }
+
+  void record(uint64_t hits, uint64_t misses) {update_stats(hits, misses, false);}
+  void record_hit()  {record(1, 0);}
+  void record_miss() {record(0, 1);}
+  void reset_stats() {update_stats(0, 0, true);}
+
+  CacheStats stats() {
+   CacheStats stats = {0, 0, 0, 0};
+   std::string buf;
+   if (read_file(stats_path(), buf)) {
+    unsigned long long hits = 0, misses = 0;
+    sscanf(buf.c_str(), "hits %llu\nmisses %llu\n", &hits, &misses);
+    stats.hits = hits;
+    stats.misses = misses;
+   }
+
+   DIR *d = opendir(dir.c_str());
+   if (d == nullptr) return stats;
+
+   for (struct dirent *ent = readdir(d); ent != nullptr; ent = readdir(d)) {
+    std::string name = ent->d_name;
+    struct stat st;
+    if (name[0] == '.' || name == "stats") continue;
+    if (stat((dir + "/" + name).c_str(), &st) != 0) continue;
+
+    stats.entries++;
+    stats.bytes += st.st_size;
+   }
+
+   closedir(d);
+   return stats;
+  }
+};
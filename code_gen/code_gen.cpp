@@ -1,16 +1,25 @@
 #include "code_gen.h"
 #include "../helpers.h"
+#include "../trace.h"
+#include "../opt_record.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <type_traits>
 using namespace Gen;
 
-Generator::Generator(TACKYifier &tackyifier) {
- this->tackyifier = &tackyifier;
- for (auto [name, entry] : *tackyifier.symbols) {
+Generator::Generator(TACKYifier &tackyifier):
+ Generator(tackyifier.get_program(), *tackyifier.symbols) {}
+
+Generator::Generator(TACKY::Program tacky_program, Parser::SymbolTable &symbols) {
+ this->tacky_program = tacky_program;
+ for (auto &[name, entry] : symbols) {
   asm_table[name] = {
    .type = entry.type == Parser::Type::Int ? AssemblyType::Longword : AssemblyType::Quadword,
    .is_static = entry.attr_type == Parser::AttrType::Static,
    .defined = entry.defined,
+   // The type checker gives every local it declares an initial value.
+   .declared = entry.attr_type == Parser::AttrType::Local &&
+               (entry.init_val_type == Parser::InitValType::InitInt || entry.init_val_type == Parser::InitValType::InitLong),
   };
  }
  
@@ -132,6 +141,7 @@ void Generator::add_inst (
     if (imm != nullptr) {
      Operand op = div.operand;
      div.operand = Register::R10;
+     div.operand.is_signed = op.is_signed;
      insts.push_back(Mov{.type = div.type, .src = op, .dst = Register::R10});
     } else {
      add_var(vars, stack_alloc_amount, div.type, div.operand);
@@ -202,9 +212,11 @@ void Generator::add_inst (
    },
    [&](Push &push) {
     add_var(vars, stack_alloc_amount, push.operand.type, push.operand);
-    bool is_quad_const = std::holds_alternative<Immediate>(push.operand.var) && push.operand.type == AssemblyType::Quadword;
+    Immediate *imm = std::get_if<Immediate>(&push.operand.var);
+    // pushq sign-extends a 32-bit immediate, so a wider one goes through R10.
+    bool is_wide_const = imm && (push.operand.type == AssemblyType::Quadword || imm->val > INT32_MAX);
 
-    if (is_quad_const) {
+    if (is_wide_const) {
      insts.push_back(Mov{.type = push.operand.type, .src = push.operand, .dst = Register::R10});
      push.operand = Register::R10;
     }
@@ -239,8 +251,9 @@ bool is_relational_op(Parser::BinaryOp op) {
 }
 
 void Generator::generate() {
- TACKY::Program program = tackyifier->get_program();
+ TACKY::Program &program = tacky_program;
  for (TACKY::Function &func : program.funcs) {
+  Trace::Scope scope("Generate function", [&] {return func.name;});
   Gen::Function function;
   function.name = func.name;
   function.global = func.global;
@@ -269,6 +282,40 @@ Gen::Binary stack_free(size_t amount) {
  return Gen::Binary{.type = AssemblyType::Quadword, .op = BinaryOp::Add, .src = amount, .dst = Register::SP};
 }
 
+static bool is_scratch(Operand &operand) {
+ Register *reg = std::get_if<Register>(&operand.var);
+ return reg && (*reg == Register::R10 || *reg == Register::R11);
+}
+
+// A temporary is any pseudo that is not a parameter or a declared local,
+// whether the TACKYifier or an optimisation pass made it.
+static void record_stats(
+ TACKY::Function &function,
+ Gen::Instructions &insts,
+ std::unordered_map<std::string, size_t> &vars,
+ AsmSymbolTable &asm_table,
+ size_t frame_size
+) {
+ OptRecord::CodegenStats stats = {0, vars.size(), frame_size, 0, 0};
+ std::unordered_set<std::string> params;
+ for (TACKY::Var &param : function.params) params.insert(param.name.to_string());
+ for (auto &[name, offset] : vars) {
+  auto entry = asm_table.find(name);
+  stats.temporaries += !params.count(name) && (entry == asm_table.end() || !entry->second.declared);
+ }
+
+ for (Gen::Instruction &inst : insts) {
+  Mov *mov = std::get_if<Mov>(&inst);
+  stats.bounce_moves += mov && (is_scratch(mov->src) || is_scratch(mov->dst));
+ }
+
+ for (TACKY::Instruction &inst : function.body) {
+  stats.calls += std::holds_alternative<TACKY::FunCall>(inst);
+ }
+
+ OptRecord::codegen(function.name.to_string(), stats);
+}
+
 static const Register regs[6] = {DI, SI, DX, CX, R8, R9};
 Gen::Instructions Generator::generate(TACKY::Function function) {
  Gen::Instructions insts;
@@ -402,6 +449,9 @@ Gen::Instructions Generator::generate(TACKY::Function function) {
      add_inst(vars, stack_alloc_amount, insts, stack_free(bytes_to_remove));
     }
 
+    // A constant destination marks a result nobody reads.
+    if (std::holds_alternative<TACKY::Constant>(inst.dst)) return;
+
     Operand dst = generate_operand(inst.dst);
     add_inst(vars, stack_alloc_amount, insts, Mov{.type = dst.type, .src = Register::AX, .dst = dst});
    },
@@ -441,5 +491,6 @@ Gen::Instructions Generator::generate(TACKY::Function function) {
 
  stack_alloc_amount += 16 - (stack_alloc_amount % 16);
  insts[0] = stack_alloc(stack_alloc_amount);
+ if (OptRecord::enabled) record_stats(function, insts, vars, asm_table, stack_alloc_amount);
  return insts;
 }
\ No newline at end of file
@@ -8,13 +8,15 @@
 struct AsmEntry {
  Gen::AssemblyType type;
  bool is_static, defined;
+ // A local variable the source declares, rather than a temporary.
+ bool declared;
 };
 
 using AsmSymbolTable = std::unordered_map<string, AsmEntry>;
 
 class Generator {
  private:
-  TACKYifier *tackyifier;
+  TACKY::Program tacky_program;
   Gen::Program program;
 
   void generate();
@@ -37,6 +39,7 @@ class Generator {
   AsmSymbolTable asm_table;
   Generator() = delete;
   Generator(TACKYifier &tackyifier);
+  Generator(TACKY::Program tacky_program, Parser::SymbolTable &symbols);
 
   Gen::Program get_program();
 };
\ No newline at end of file
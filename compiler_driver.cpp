@@ -1,44 +1,460 @@
 #include <iostream>
-#include <queue>
+#include <iomanip>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include "cache.h"
+#include "lto/object.h"
 using std::string;
 
-int main(int argc, char* argv[]) {
- string filename, src, stage = "";
- std::queue<string> args;
- bool dont_link = false;
+extern char **environ;
 
- for (int i = 1; i < argc; i++) {
-  args.push(argv[i]);
+struct Job {
+ string src, stem, object, summary, source;
+ std::vector<string> flags;
+ double ms = 0;
+};
+
+static string compiler, tmp_dir, stage = "", cache_dir;
+static std::vector<string> compiler_flags;
+static bool dont_link = false, use_cache = false, lto = false, thin_lto = false, time_trace = false, opt_record = false;
+
+static std::mutex children_lock;
+static std::set<pid_t> children;
+static std::atomic<bool> failed(false);
+
+// -O<level>, --passes= and --time-passes go to every compile and, with
+// -flto, to the link step where the optimiser then runs.
+bool is_optimisation_flag(const string &arg) {
+ return (arg.substr(0, 2) == "-O" && arg.size() <= 3) || arg.substr(0, 9) == "--passes=" || arg == "--time-passes";
+}
+
+// A cache hit skips the compiler, so a compile that has to write a trace, an
+// optimisation record or one of the reports the compiler prints always runs.
+bool writes_report() {
+ if (time_trace || opt_record) return true;
+ for (string &flag : compiler_flags) {
+  if (flag.substr(0, 13) == "-ftime-trace=" || flag.substr(0, 27) == "-fsave-optimization-record=") return true;
+  if (flag.substr(0, 12) == "-fmem-report" || flag == "--perf-counters" || flag == "--time-passes") return true;
  }
+ return false;
+}
 
- for (string arg = args.front(); !args.empty(); args.pop(), arg = args.front()) {
-  dont_link = dont_link || arg == "-c";
+string compiler_path(const char *argv0) {
+ if (const char *env = getenv("C_COMPILER"); env && *env) return env;
 
-  if (arg.substr(0, 2) == "--") {
-   stage = arg;
-  } else if (arg != "-c") {
-   for (int i = 0; i < arg.size(); i++) {
-    if (arg[i] == '.') filename = src;
-    
-    src += arg[i];
-   } 
+ // build/compiler lives next to build/compiler_driver.
+ char buf[PATH_MAX];
+ ssize_t len = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+ string self = len > 0 ? string(buf, len) : string(argv0);
+ size_t slash = self.rfind('/');
+
+ return slash == string::npos ? "compiler" : self.substr(0, slash) + "/compiler";
+}
+
+// Pipes are close-on-exec so that children spawned by other workers do not
+// inherit them; creating them under the spawn lock closes the window between
+// pipe() and fcntl().
+void make_pipe(int fds[2]) {
+ std::lock_guard<std::mutex> guard(children_lock);
+ if (pipe(fds) != 0) {
+  fds[0] = fds[1] = -1;
+  return;
+ }
+
+ fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+ fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+}
+
+// Starts a command with the given stdin/stdout (-1 inherits the driver's).
+// Children are tracked so a failing job can stop the others.
+pid_t spawn(std::vector<string> args, int in, int out) {
+ std::vector<char *> argv;
+ for (string &arg : args) argv.push_back(arg.data());
+ argv.push_back(nullptr);
+
+ posix_spawn_file_actions_t actions;
+ posix_spawn_file_actions_init(&actions);
+ if (in  != -1) posix_spawn_file_actions_adddup2(&actions, in, 0);
+ if (out != -1) posix_spawn_file_actions_adddup2(&actions, out, 1);
+
+ pid_t pid = -1;
+ {
+  std::lock_guard<std::mutex> guard(children_lock);
+  if (!failed && posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) != 0) {
+   std::cerr << "Could not run " << args[0] << '\n';
+   pid = -1;
+  }
+
+  if (pid != -1) children.insert(pid);
+ }
+
+ posix_spawn_file_actions_destroy(&actions);
+ return pid;
+}
+
+int wait_for(pid_t pid) {
+ if (pid == -1) return failed ? 1 : 127;
+
+ int status;
+ while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+ {
+  std::lock_guard<std::mutex> guard(children_lock);
+  children.erase(pid);
+ }
+
+ if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+ return WEXITSTATUS(status);
+}
+
+// Runs cmds[0] | cmds[1] | ... with every stage running at once. `input` is
+// written to the first command's stdin and `output` collects the last one's
+// stdout; otherwise those are inherited. Returns the first failing status in
+// pipeline order.
+int pipeline(std::vector<std::vector<string>> cmds, const string *input = nullptr, string *output = nullptr) {
+ std::vector<pid_t> pids;
+ int in = -1, feed = -1, fds[2];
+
+ if (input != nullptr) {
+  make_pipe(fds);
+  in = fds[0];
+  feed = fds[1];
+ }
+
+ for (size_t i = 0; i < cmds.size(); i++) {
+  int out = -1, next_in = -1;
+  if (i + 1 < cmds.size() || output != nullptr) {
+   make_pipe(fds);
+   out = fds[1];
+   next_in = fds[0];
   }
+
+  pids.push_back(spawn(cmds[i], in, out));
+  if (in != -1)  close(in);
+  if (out != -1) close(out);
+  in = next_in;
+ }
+
+ for (size_t written = 0; feed != -1 && written < input->size();) {
+  ssize_t n = write(feed, input->data() + written, input->size() - written);
+  if (n < 0 && errno == EINTR) continue;
+  if (n <= 0) break;
+
+  written += n;
+ }
+ if (feed != -1) close(feed);
+
+ if (output != nullptr) {
+  char buf[65536];
+  for (ssize_t n; (n = read(in, buf, sizeof(buf))) != 0;) {
+   if (n < 0 && errno == EINTR) continue;
+   if (n < 0) break;
+
+   output->append(buf, n);
+  }
+  close(in);
+ }
+
+ int status = 0;
+ for (pid_t pid : pids) {
+  int exit = wait_for(pid);
+  if (status == 0) status = exit;
+ }
+
+ return status;
+}
+
+void stop_all() {
+ std::lock_guard<std::mutex> guard(children_lock);
+ failed = true;
+
+ for (pid_t pid : children) {
+  kill(pid, SIGTERM);
  }
+}
+
+// Preprocessor, compiler and assembler are connected by pipes, so nothing but
+// the object touches the disk.
+int compile(Job &job) {
+ std::vector<string> preprocess = {"gcc", "-E", "-P", job.src};
+ std::vector<string> assemble = {"gcc", "-x", "assembler", "-c", "-", "-o", job.object};
+ std::vector<string> cc = {compiler, "-", "-"};
+ if (stage != "") cc.push_back(stage);
+ cc.insert(cc.end(), compiler_flags.begin(), compiler_flags.end());
+ cc.insert(cc.end(), job.flags.begin(), job.flags.end());
+ if (time_trace) cc.push_back("-ftime-trace=" + job.stem + ".json");
+ if (opt_record) cc.push_back("-fsave-optimization-record=" + job.stem + ".opt.json");
 
+ if (stage != "") return pipeline({preprocess, cc});
+ if (thin_lto)    return pipeline({cc, assemble}, &job.source);
+ if (!use_cache || writes_report()) return pipeline({preprocess, cc, assemble});
+
+ // The key needs the whole preprocessed source, so with the cache on the
+ // driver buffers it instead of connecting gcc -E to the compiler.
+ string key, contents, object;
  int exit;
- string cmd = "gcc -E -P " + src + " -o pre.i";
- if ((exit = system(cmd.c_str()))) return WEXITSTATUS(exit);
+ if ((exit = pipeline({preprocess}, nullptr, &contents))) return exit;
+
+ {
+  ContentCache cache(cache_dir);
+  Hasher hasher;
+  hasher.add(contents);
+  for (string &flag : compiler_flags) hasher.add(flag);
+  key = hasher.add(file_fingerprint(compiler)).hex();
 
- cmd = "~/Documents/c-compiler/build/compiler pre.i asm.s ";
- if (stage != "") cmd += stage;
- if ((exit = system(cmd.c_str()))) return WEXITSTATUS(exit);
- if ((exit = system("rm pre.i")))  return WEXITSTATUS(exit);
+  if (cache.lookup(key, "o", object)) {
+   std::ofstream out(job.object, std::ios::binary);
+   out << object;
+   out.close();
 
- if (stage != "") return 0;
+   if (out) {
+    cache.record_hit();
+    return 0;
+   }
+  }
+
+  cache.record_miss();
+ }
+
+ if ((exit = pipeline({cc, assemble}, &contents))) return exit;
+
+ if (read_file(job.object, object)) {
+  ContentCache(cache_dir).store(key, "o", object);
+ }
 
- cmd  = string("gcc ") + (dont_link ? "-c " : "");
- cmd += "asm.s -o " + filename + (dont_link ? ".o" : "");// + " && rm asm.s";
- if ((exit = system(cmd.c_str()))) return WEXITSTATUS(exit);
- 
  return 0;
-}
\ No newline at end of file
+}
+
+// First pass of -flto=thin: only the module's summary is written, and the
+// preprocessed source is kept for the second pass.
+int summarise(Job &job) {
+ std::vector<string> preprocess = {"gcc", "-E", "-P", job.src};
+ std::vector<string> cc = {compiler, "-", "-", "--tacky", "--emit-summary=" + job.summary};
+ cc.insert(cc.end(), compiler_flags.begin(), compiler_flags.end());
+
+ int exit = pipeline({preprocess}, nullptr, &job.source);
+ return exit ? exit : pipeline({cc}, &job.source);
+}
+
+// Runs `step` over the jobs on `num_workers` threads, stopping everything at
+// the first failure. Returns the failing exit status.
+int run_jobs(std::vector<Job> &jobs, size_t num_workers, int (*step)(Job &), bool show_timings) {
+ std::atomic<size_t> next(0);
+ std::mutex report_lock;
+ int first_error = 0;
+
+ std::vector<std::thread> workers;
+ for (size_t w = 0; w < std::min(num_workers, jobs.size()); w++) {
+  workers.emplace_back([&]() {
+   for (size_t i = next++; i < jobs.size() && !failed; i = next++) {
+    auto start = std::chrono::steady_clock::now();
+    int exit = step(jobs[i]);
+    jobs[i].ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> guard(report_lock);
+    if (exit != 0) {
+     if (!failed) {
+      first_error = exit;
+      std::cerr << "Failed to compile " << jobs[i].src << '\n';
+     }
+
+     stop_all();
+    } else if (show_timings) {
+     std::cerr << std::fixed << std::setprecision(1) << std::setw(9) << jobs[i].ms << " ms  " << jobs[i].src << '\n';
+    }
+   }
+  });
+ }
+
+ for (std::thread &worker : workers) {
+  worker.join();
+ }
+
+ return first_error;
+}
+
+void remove_tmp_dir() {
+ DIR *dir = opendir(tmp_dir.c_str());
+ if (dir == nullptr) return;
+
+ for (struct dirent *ent = readdir(dir); ent != nullptr; ent = readdir(dir)) {
+  if (ent->d_name[0] != '.') unlink((tmp_dir + "/" + ent->d_name).c_str());
+ }
+
+ closedir(dir);
+ rmdir(tmp_dir.c_str());
+}
+
+int main(int argc, char* argv[]) {
+ std::vector<Job> jobs;
+ std::vector<string> link_inputs;
+ string output;
+ size_t num_workers = 1;
+ bool show_cache_stats = false, function_cache = false, show_timings = false;
+
+ signal(SIGPIPE, SIG_IGN);
+ use_cache = getenv("C_COMPILER_CACHE") != nullptr;
+ cache_dir = ContentCache::default_dir();
+ compiler = compiler_path(argv[0]);
+
+ for (int i = 1; i < argc; i++) {
+  string arg = argv[i];
+
+  if (arg == "-c") {
+   dont_link = true;
+  } else if (arg == "-o" && i + 1 < argc) {
+   output = argv[++i];
+  } else if (arg.substr(0, 2) == "-j") {
+   string count = arg.size() > 2 ? arg.substr(2) : (i + 1 < argc ? argv[++i] : "");
+   num_workers = std::max(1, atoi(count.c_str()));
+  } else if (arg == "--cache") {
+   use_cache = true;
+  } else if (arg.substr(0, 12) == "--cache-dir=") {
+   use_cache = true;
+   cache_dir = arg.substr(12);
+  } else if (arg == "--cache-stats") {
+   show_cache_stats = true;
+  } else if (arg == "--function-cache") {
+   function_cache = true;
+  } else if (arg == "-flto") {
+   lto = true;
+   compiler_flags.push_back(arg);
+  } else if (arg == "-flto=thin") {
+   thin_lto = true;
+  } else if (arg == "-ftime-trace") {
+   time_trace = true;
+  } else if (arg == "-fsave-optimization-record") {
+   opt_record = true;
+  } else if (arg.substr(0, 13) == "-ftime-trace=" || arg.substr(0, 27) == "-fsave-optimization-record=" || arg.substr(0, 12) == "-fmem-report" || arg == "--perf-counters") {
+   compiler_flags.push_back(arg);
+  } else if (arg == "--timings") {
+   show_timings = true;
+  } else if (arg.substr(0, 16) == "--decl-snapshot=" || arg.substr(0, 21) == "--emit-decl-snapshot=" ||
+             arg.substr(0, 10) == "--opt-max-" || is_optimisation_flag(arg)) {
+   compiler_flags.push_back(arg);
+  } else if (arg.substr(0, 2) == "--") {
+   stage = arg;
+  } else {
+   size_t dot = arg.rfind('.');
+   string ext = dot == string::npos ? "" : arg.substr(dot);
+   if (ext != ".c") {
+    link_inputs.push_back(arg);
+    continue;
+   }
+
+   Job job;
+   job.src = arg;
+   job.stem = arg.substr(0, dot);
+   jobs.push_back(job);
+  }
+ }
+
+ if (function_cache) {
+  compiler_flags.push_back("--function-cache=" + cache_dir + "/functions");
+ }
+
+ if (show_cache_stats) {
+  CacheStats stats = ContentCache(cache_dir).stats();
+  uint64_t lookups = stats.hits + stats.misses;
+
+  std::cout << "cache directory: " << cache_dir    << '\n'
+            << "hits:            " << stats.hits    << '\n'
+            << "misses:          " << stats.misses  << '\n'
+            << "hit rate:        " << (lookups ? 100 * stats.hits / lookups : 0) << "%\n"
+            << "entries:         " << stats.entries << '\n'
+            << "size:            " << stats.bytes   << " bytes\n";
+  return 0;
+ }
+
+ if (jobs.empty() && link_inputs.empty()) {
+  std::cerr << "No input files.\n";
+  return 1;
+ }
+
+ const char *tmp_env = getenv("TMPDIR");
+ string tmp_template = string(tmp_env && *tmp_env ? tmp_env : "/tmp") + "/c-compiler.XXXXXX";
+ if (mkdtemp(tmp_template.data()) == nullptr) {
+  std::cerr << "Could not create a temporary directory.\n";
+  return 1;
+ }
+ tmp_dir = tmp_template;
+
+ for (size_t i = 0; i < jobs.size(); i++) {
+  jobs[i].object = dont_link ? jobs[i].stem + ".o" : tmp_dir + "/" + std::to_string(i) + ".o";
+ }
+
+ if (dont_link && output != "" && jobs.size() == 1) {
+  jobs[0].object = output;
+ }
+
+ int first_error = 0;
+ show_timings = show_timings || jobs.size() > 1;
+
+ // -flto=thin summarises every file first; each file is then compiled
+ // against the summaries of all the others, so no process ever holds more
+ // than one module.
+ thin_lto = thin_lto && stage == "";
+ if (thin_lto) {
+  for (size_t i = 0; i < jobs.size(); i++) {
+   jobs[i].summary = tmp_dir + "/" + std::to_string(i) + ".summary";
+  }
+
+  for (Job &job : jobs) {
+   string others;
+   for (Job &other : jobs) {
+    if (&other != &job) others += (others == "" ? "" : ",") + other.summary;
+   }
+
+   if (others != "") job.flags.push_back("--import-summaries=" + others);
+   if (!dont_link && link_inputs.empty()) job.flags.push_back("--internalise");
+  }
+
+  first_error = run_jobs(jobs, num_workers, summarise, false);
+ }
+
+ if (!failed) first_error = run_jobs(jobs, num_workers, compile, show_timings);
+
+ if (!failed && !dont_link && stage == "") {
+  std::vector<string> objects, lto_objects;
+  for (Job &job : jobs) (lto ? lto_objects : objects).push_back(job.object);
+  for (string &input : link_inputs) {
+   (is_lto_object(input) ? lto_objects : objects).push_back(input);
+  }
+
+  // The -flto objects are optimised and compiled together into one real
+  // object. Only when they are the whole program can their external
+  // functions be treated as internal.
+  if (!lto_objects.empty()) {
+   string lto_asm = tmp_dir + "/lto.s", lto_obj = tmp_dir + "/lto.o";
+   std::vector<string> cmd = {compiler, "--lto", lto_asm};
+   cmd.insert(cmd.end(), lto_objects.begin(), lto_objects.end());
+   if (objects.empty()) cmd.push_back("--internalise");
+   for (string &flag : compiler_flags) {
+    if (flag.substr(0, 10) == "--opt-max-" || is_optimisation_flag(flag)) cmd.push_back(flag);
+   }
+   if (opt_record) cmd.push_back("-fsave-optimization-record=" + (output != "" ? output : jobs.empty() ? "a.out" : jobs[0].stem) + ".opt.json");
+
+   first_error = pipeline({cmd});
+   if (first_error == 0) first_error = pipeline({{"gcc", "-c", lto_asm, "-o", lto_obj}});
+   objects.insert(objects.begin(), lto_obj);
+  }
+
+  std::vector<string> cmd = {"gcc"};
+  cmd.insert(cmd.end(), objects.begin(), objects.end());
+  cmd.push_back("-o");
+  cmd.push_back(output != "" ? output : jobs.empty() ? "a.out" : jobs[0].stem);
+
+  if (first_error == 0) first_error = pipeline({cmd});
+ }
+
+ remove_tmp_dir();
+ return first_error;
+}
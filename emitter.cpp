@@ -1,8 +1,9 @@
 #include "emitter.h"
 #include "helpers.h"
+#include "trace.h"
 using namespace Gen;
 
-Emitter::Emitter(Generator &gen): gen(&gen), symbols(gen.asm_table) {
+Emitter::Emitter(Generator &gen, FunctionCache *cache): gen(&gen), cache(cache), symbols(gen.asm_table) {
  emit();
 }
 
@@ -18,21 +19,42 @@ void Emitter::emit() {
  }
 
  code += "    .text\n";
- for (Gen::Function &function : program.funcs) {
-  std::string function_name = function.name.to_string();
-  code += function.global ? "    .globl " + function_name + '\n' : "";
-  code += function_name + ":\n";
-  code += "    pushq %rbp\n";
-  code += "    movq %rsp, %rbp\n";
-  
-  for (Gen::Instruction &inst : function.instructions) {
-   emit_instruction(inst);
-  } code += '\n';
+ if (cache == nullptr) {
+  for (Gen::Function &function : program.funcs) {
+   emit_function(function);
+  }
+ } else {
+  // Functions that hit the cache were never lowered; splice them back in
+  // between the freshly generated ones, in source order.
+  size_t next = 0;
+  std::string cached;
+  for (std::string &name : cache->get_order()) {
+   if (cache->get(name, cached)) {
+    code += cached;
+   } else if (next < program.funcs.size()) {
+    size_t start = code.size();
+    emit_function(program.funcs[next++]);
+    cache->store(name, code.substr(start));
+   }
+  }
  }
 
  code += "\n.section .note.GNU-stack,\"\",@progbits\n";
 }
 
+void Emitter::emit_function(Gen::Function &function) {
+ Trace::Scope scope("Emit function", [&] {return function.name;});
+ function_name = function.name.to_string();
+ code += function.global ? "    .globl " + function_name + '\n' : "";
+ code += function_name + ":\n";
+ code += "    pushq %rbp\n";
+ code += "    movq %rsp, %rbp\n";
+
+ for (Gen::Instruction &inst : function.instructions) {
+  emit_instruction(inst);
+ } code += '\n';
+}
+
 string cond_code(Condition cond) {
  string code;
  
@@ -150,13 +172,13 @@ void Emitter::emit_instruction(Gen::Instruction &inst) {
    code += ", ";  emit_operand(cmp.op2, cmp.type);
   },
   [&](Gen::Label &label) {
-   code += ".L" + label.name.to_string() + ":";
+   code += ".L" + function_name + "." + label.name.to_string() + ":";
   },
   [&](Jmp &jmp) {
-   code += "jmp .L" + jmp.target.to_string();
+   code += "jmp .L" + function_name + "." + jmp.target.to_string();
   },
   [&](Conditional_Jmp &jmp) {
-   code += "j" + cond_code(jmp.condition) + " .L" + jmp.target.to_string();
+   code += "j" + cond_code(jmp.condition) + " .L" + function_name + "." + jmp.target.to_string();
   },
   [&](Set_Condition &set) {
    code += "set" + cond_code(set.condition) + " ";
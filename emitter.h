@@ -2,21 +2,25 @@
 #include "code_gen/code_gen.h"
 #include "lexer/tokens.h"
 #include "parser/parser.h"
+#include "function_cache.h"
 
 class Emitter {
  private:
   Generator *gen;
+  FunctionCache *cache;
   std::string code;
+  std::string function_name;
   AsmSymbolTable &symbols;
 
   void emit();
+  void emit_function(Gen::Function &function);
   void emit_var(Gen::StaticVariable &var);
   void emit_type(Gen::AssemblyType &type);
   void emit_instruction(Gen::Instruction &inst);
   void emit_operand(Gen::Operand &operand, Gen::AssemblyType type, bool is_dst = false);
  public:
   Emitter() = delete;
-  Emitter(Generator &gen);
+  Emitter(Generator &gen, FunctionCache *cache = nullptr);
 
   std::string get_code();
 };
\ No newline at end of file
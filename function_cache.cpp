@@ -0,0 +1,79 @@
+#include "function_cache.h"
+#include "helpers.h"
+
+FunctionCache::FunctionCache(std::string dir, std::string flags): cache(dir) {
+ salt = Hasher()
+  .add(string("function-cache-v1"))
+  .add(file_fingerprint("/proc/self/exe"))
+  .add(flags)
+  .hex();
+}
+
+std::string FunctionCache::make_key(Lexer &lexer, Parser::SymbolTable &symbols, Parser::FuncDecl &func) {
+ Hasher hasher;
+ hasher.add(salt);
+
+ for (size_t i = func.token_start; i < func.token_end; i++) {
+  Token &token = lexer.tokens[i];
+  hasher.add((uint64_t)token.type).add(token.start, token.length);
+  if (token.type != TokenType::Identifier) continue;
+
+  // Block-scope names were renamed during resolution, so only file-scope
+  // symbols (or locals shadowing one, which is harmless) are found here.
+  auto it = symbols.find(string(token.start, token.length));
+  if (it == symbols.end()) continue;
+
+  Parser::TypeEntry &entry = it->second;
+  hasher.add((uint64_t)entry.type).add((uint64_t)entry.global);
+  if (entry.type == Parser::Type::Function) {
+   hasher.add((uint64_t)entry.ret_type).add((uint64_t)entry.defined);
+   for (Parser::Type type : entry.param_types) {
+    hasher.add((uint64_t)type);
+   }
+  } else hasher.add((uint64_t)entry.attr_type);
+ }
+
+ return hasher.hex();
+}
+
+std::unordered_set<std::string> FunctionCache::lookup(Lexer &lexer, Parser::CParser &parser) {
+ std::unordered_set<std::string> cached;
+ Parser::Program program = parser.get_program();
+
+ for (Parser::Declaration &decl : program.decls) {
+  Parser::FuncDecl *func = std::get_if<Parser::FuncDecl>(&decl);
+  if (func == nullptr || func->body == nullptr) continue;
+
+  std::string name = func->name.to_string();
+  std::string key = make_key(lexer, parser.symbols, *func);
+  std::string code;
+
+  order.push_back(name);
+  keys[name] = key;
+  if (cache.lookup(key, "s", code)) {
+   hits[name] = code;
+   cached.insert(name);
+  }
+ }
+
+ cache.record(hits.size(), order.size() - hits.size());
+ return cached;
+}
+
+std::vector<std::string> &FunctionCache::get_order() {
+ return order;
+}
+
+bool FunctionCache::get(std::string name, std::string &code) {
+ auto it = hits.find(name);
+ if (it == hits.end()) return false;
+
+ code = it->second;
+ return true;
+}
+
+void FunctionCache::store(std::string name, const std::string &code) {
+ if (keys.count(name) && !hits.count(name)) {
+  cache.store(keys[name], "s", code);
+ }
+}
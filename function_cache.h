@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "cache.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+
+// Caches the emitted assembly of each function definition. The key covers the
+// function's own tokens and the signatures of the file-scope symbols it names,
+// so a hit can be spliced into the output without lowering the function again.
+class FunctionCache {
+ private:
+  ContentCache cache;
+  std::string salt;
+  std::vector<std::string> order;
+  std::unordered_map<std::string, std::string> keys;
+  std::unordered_map<std::string, std::string> hits;
+
+  std::string make_key(Lexer &lexer, Parser::SymbolTable &symbols, Parser::FuncDecl &func);
+
+ public:
+  FunctionCache() = delete;
+  FunctionCache(std::string dir, std::string flags);
+
+  std::unordered_set<std::string> lookup(Lexer &lexer, Parser::CParser &parser);
+  std::vector<std::string> &get_order();
+  bool get(std::string name, std::string &code);
+  void store(std::string name, const std::string &code);
+};
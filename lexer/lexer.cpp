@@ -3,15 +3,20 @@
 #include "lexer.h"
 #include "../helpers.h"
 
-Lexer::Lexer(string src) {
- start = current = 0;
+Lexer::Lexer(string src, size_t offset, int line) {
+ start = current = offset;
  column = 1;
- line = 1;
+ this->line = line;
  this->src = src;
 
  tokenise();
 }
 
+// Byte offset of tokens[index], or the end of the source past the last token.
+size_t Lexer::offset(size_t index) {
+ return index < tokens.size() ? tokens[index].start - src.data() : src.size();
+}
+
 bool Lexer::at_end() {return current >= src.length();}
 void Lexer::advance() {start = current;}
 char Lexer::peek(int advance) {return src[current + advance];}
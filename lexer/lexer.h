@@ -32,7 +32,9 @@ class Lexer {
   std::vector<Token> tokens;
   
   Lexer() = delete;
-  Lexer(string src);
+  Lexer(string src, size_t offset = 0, int line = 1);
+
+  size_t offset(size_t index);
 
   void print_tokens(int start = 0);
 };
@@ -189,10 +189,6 @@ struct Token {
  size_t length, line;
  
  string to_string() {
-  char *cstr = new char[length + 1];
-  cstr[length] = 0;
-  strncpy(cstr, start, length);
-  
-  return string(cstr);
+  return string(start, length);
  }
 };
\ No newline at end of file
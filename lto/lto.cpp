@@ -0,0 +1,414 @@
+#include <optional>
+#include <unordered_set>
+#include "lto.h"
+#include "object.h"
+#include "../tacky/serialise.h"
+#include "../helpers.h"
+#include "../opt_record.h"
+#include "../optimiser/budget.h"
+
+std::string lto_object(const std::string &tacky) {
+ std::string code = "    .section " LTO_SECTION ",\"e\",@progbits\n";
+
+ for (size_t i = 0; i < tacky.size(); i++) {
+  code += i % 16 == 0 ? "    .byte " : ",";
+  code += std::to_string((unsigned char)tacky[i]);
+  if (i % 16 == 15 || i + 1 == tacky.size()) code += '\n';
+ }
+
+ code += "\n.section .note.GNU-stack,\"\",@progbits\n";
+ return code;
+}
+
+static bool is_initial(Parser::InitValType type) {
+ return type == Parser::InitValType::InitInt || type == Parser::InitValType::InitLong;
+}
+
+LinkTimeOptimiser::LinkTimeOptimiser(std::vector<std::string> objects, bool internalise) {
+ this->internalise = internalise;
+ inline_count = 0;
+
+ for (size_t i = 0; i < objects.size(); i++) {
+  size_t size, length;
+  const char *start, *data = map_file(objects[i], size);
+  if (data == nullptr) error("Could not read " + objects[i]);
+  if (!find_section(data, size, LTO_SECTION, start, length)) {
+   error(objects[i] + " was not compiled with -flto.");
+  }
+
+  TACKY::Program module;
+  Parser::SymbolTable module_symbols;
+  if (!TACKY::deserialise(start, length, module, module_symbols)) {
+   error("Corrupt TACKY in " + objects[i]);
+  }
+
+  merge(module, module_symbols, i);
+ }
+
+ OptRecord::pass("merge", program);
+ propagate_constant_args();
+ OptRecord::pass("propagate-constant-args", program);
+ inline_calls();
+ OptRecord::pass("inline", program);
+ remove_dead_functions();
+ OptRecord::pass("remove-dead-functions", program);
+}
+
+TACKY::Program LinkTimeOptimiser::get_program() {
+ return program;
+}
+
+Parser::SymbolTable &LinkTimeOptimiser::get_symbols() {
+ return symbols;
+}
+
+void LinkTimeOptimiser::merge(TACKY::Program &module, Parser::SymbolTable &module_symbols, int index) {
+ std::unordered_map<std::string, Token> renames;
+ std::string suffix = ".lto" + std::to_string(index);
+
+ for (auto &[name, entry] : module_symbols) {
+  if (!entry.global) {
+   renames[name] = make_name(name + suffix);
+   symbols[name + suffix] = entry;
+   continue;
+  }
+
+  auto it = symbols.find(name);
+  if (it == symbols.end()) {
+   symbols[name] = entry;
+   continue;
+  }
+
+  Parser::TypeEntry &old = it->second;
+  if (old.type != entry.type) error(name + " is declared with different types.");
+
+  if (entry.type == Parser::Type::Function) {
+   if (entry.defined && old.defined) error(name + " is defined more than once.");
+   if (entry.defined) old = entry;
+  } else if (is_initial(entry.init_val_type)) {
+   if (is_initial(old.init_val_type)) error(name + " is defined more than once.");
+   old = entry;
+  } else if (entry.init_val_type == Parser::InitValType::Tentative && old.init_val_type == Parser::InitValType::None) {
+   old = entry;
+  }
+ }
+
+ auto rename = [&](Token &name) {
+  auto it = renames.find(name_of(name));
+  if (it != renames.end()) name = it->second;
+ };
+
+ // Tentative definitions of the same global are merged into one, which an
+ // initialised definition takes the place of.
+ for (TACKY::StaticVariable &var : module.statics) {
+  rename(var.name);
+
+  std::string var_name = name_of(var.name);
+  auto it = static_index.find(var_name);
+
+  if (it == static_index.end()) {
+   static_index[var_name] = program.statics.size();
+   program.statics.push_back(var);
+  } else if (var.global && is_initial(module_symbols[var_name].init_val_type)) {
+   program.statics[it->second] = var;
+  }
+ }
+
+ for (TACKY::Function &func : module.funcs) {
+  rename(func.name);
+  for (TACKY::Var &param : func.params) rename(param.name);
+  for (TACKY::Instruction &inst : func.body) for_each_name(inst, rename);
+
+  program.funcs.push_back(std::move(func));
+ }
+}
+
+bool LinkTimeOptimiser::is_internal(std::string name) {
+ return name != "main" && (internalise || !symbols[name].global);
+}
+
+// A parameter that every caller passes the same constant for becomes a local
+// initialised to it, and the argument is dropped from each call.
+void LinkTimeOptimiser::propagate_constant_args() {
+ struct CallSite {
+  TACKY::Function *caller;
+  size_t index;
+ };
+
+ std::unordered_map<std::string, std::vector<CallSite>> calls;
+ std::unordered_map<TACKY::Function *, std::unordered_map<std::string, TACKY::Constant>> constants;
+
+ for (TACKY::Function &func : program.funcs) {
+  // Locals assigned exactly once, by a copy of a constant, hold it wherever
+  // they are read; TACKYifier puts every argument in such a temporary.
+  std::unordered_map<std::string, int> defs;
+  std::unordered_map<std::string, TACKY::Constant> &consts = constants[&func];
+  for (TACKY::Var &param : func.params) defs[name_of(param.name)]++;
+
+  for (size_t i = 0; i < func.body.size(); i++) {
+   TACKY::Instruction &inst = func.body[i];
+   if (TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst); call) {
+    calls[name_of(call->name)].push_back({&func, i});
+   }
+
+   TACKY::Value *dst = get_dst(inst);
+   TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+   if (var == nullptr) continue;
+
+   std::string name = name_of(var->name);
+   TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst);
+   if (++defs[name] == 1 && copy && std::holds_alternative<TACKY::Constant>(copy->src)) {
+    consts[name] = std::get<TACKY::Constant>(copy->src);
+   } else {
+    consts.erase(name);
+   }
+  }
+
+  for (auto it = consts.begin(); it != consts.end();) {
+   auto entry = symbols.find(it->first);
+   bool local = entry != symbols.end() && entry->second.attr_type == Parser::AttrType::Local;
+   it = local && defs[it->first] == 1 ? std::next(it) : consts.erase(it);
+  }
+ }
+
+ auto constant_arg = [&](CallSite &site, size_t param, TACKY::Constant &out) {
+  TACKY::Value &arg = std::get<TACKY::FunCall>(site.caller->body[site.index]).args[param];
+  if (TACKY::Constant *_const = std::get_if<TACKY::Constant>(&arg); _const) {
+   out = *_const;
+   return true;
+  }
+
+  auto &consts = constants[site.caller];
+  auto it = consts.find(name_of(std::get<TACKY::Var>(arg).name));
+  if (it == consts.end()) return false;
+
+  out = it->second;
+  return true;
+ };
+
+ // Prologues are added at the end so that call site indices stay valid.
+ std::unordered_map<TACKY::Function *, std::vector<TACKY::Instruction>> prologues;
+ for (TACKY::Function &func : program.funcs) {
+  std::string name = name_of(func.name);
+  auto it = calls.find(name);
+  if (it != calls.end() && !is_internal(name) && !func.params.empty() && OptRecord::enabled) {
+   OptRecord::remark(name, "propagate-constant-args", false, "callers outside the program may pass other arguments");
+  }
+  if (!is_internal(name) || it == calls.end()) continue;
+
+  for (size_t p = func.params.size(); p-- > 0;) {
+   std::optional<TACKY::Constant> value;
+   bool same = true;
+
+   for (CallSite &site : it->second) {
+    TACKY::Constant arg;
+    if (std::get<TACKY::FunCall>(site.caller->body[site.index]).args.size() != func.params.size()) {
+     same = false;
+    } else if (!constant_arg(site, p, arg) || arg.type != func.params[p].type) {
+     same = false;
+    } else if (value && value->_const != arg._const) {
+     same = false;
+    }
+
+    if (!same) break;
+    value = arg;
+   }
+
+   if (!same) continue;
+
+   if (OptRecord::enabled) {
+    std::string param = name_of(func.params[p].name);
+    OptRecord::remark(name, "propagate-constant-args", true, "parameter " + param + " is always " + std::to_string((long)value->_const));
+   }
+
+   prologues[&func].push_back(TACKY::Copy(*value, func.params[p]));
+   func.params.erase(func.params.begin() + p);
+   std::vector<Parser::Type> &param_types = symbols[name].param_types;
+   if (p < param_types.size()) param_types.erase(param_types.begin() + p);
+
+   for (CallSite &site : it->second) {
+    std::vector<TACKY::Value> &args = std::get<TACKY::FunCall>(site.caller->body[site.index]).args;
+    args.erase(args.begin() + p);
+   }
+  }
+ }
+
+ for (auto &[func, prologue] : prologues) {
+  func->body.insert(func->body.begin(), prologue.begin(), prologue.end());
+ }
+}
+
+void LinkTimeOptimiser::inline_calls() {
+ // Callees are inlined as they were before this pass, so a call that an
+ // inlined body brings in is never expanded again.
+ std::unordered_map<std::string, TACKY::Function> callees;
+ std::unordered_map<std::string, std::string> rejected;
+ for (TACKY::Function &func : program.funcs) {
+  std::string name = name_of(func.name);
+  if (func.body.size() > max_inline_size) {
+   rejected[name] = std::to_string(func.body.size()) + " instructions is over the limit of " + std::to_string(max_inline_size);
+   continue;
+  }
+
+  bool recursive = false;
+  for (TACKY::Instruction &inst : func.body) {
+   TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst);
+   recursive = recursive || (call && name_of(call->name) == name);
+  }
+
+  if (!recursive) callees.emplace(name, func);
+  else rejected[name] = "it is recursive";
+ }
+
+ for (TACKY::Function &func : program.funcs) {
+  // Inlining only makes a function that is over budget bigger.
+  if (Optimiser::tier(func, "inline") != Optimiser::Tier::Full) continue;
+
+  std::vector<TACKY::Instruction> body;
+  body.reserve(func.body.size());
+
+  for (TACKY::Instruction &inst : func.body) {
+   TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst);
+   auto it = call ? callees.find(name_of(call->name)) : callees.end();
+
+   if (it == callees.end() || it->first == name_of(func.name) || it->second.params.size() != call->args.size()) {
+    if (call && OptRecord::enabled) {
+     std::string callee = name_of(call->name);
+     auto reason = rejected.find(callee);
+     if (reason != rejected.end()) {
+      OptRecord::remark(name_of(func.name), "inline", false, "not inlining " + callee + ": " + reason->second);
+     } else if (it != callees.end() && it->first != name_of(func.name)) {
+      OptRecord::remark(name_of(func.name), "inline", false, "not inlining " + callee + ": wrong number of arguments");
+     }
+    }
+
+    body.push_back(inst);
+    continue;
+   }
+
+   OptRecord::remark(name_of(func.name), "inline", true, "inlined " + it->first);
+   inline_call(body, *call, it->second, symbols, symbols, inline_count);
+  }
+
+  func.body = std::move(body);
+ }
+}
+
+// Locals and labels of the callee get a suffix unique to this call site;
+// statics, globals and functions keep their names.
+void inline_call(
+ std::vector<TACKY::Instruction> &body,
+ TACKY::FunCall &call,
+ TACKY::Function &callee,
+ Parser::SymbolTable &callee_symbols,
+ Parser::SymbolTable &symbols,
+ int &inline_count
+) {
+ std::string suffix = ".inl" + std::to_string(inline_count++);
+ std::unordered_map<std::string, Token> renames;
+
+ auto rename = [&](Token &token) {
+  std::string name = name_of(token);
+  auto it = renames.find(name);
+  if (it != renames.end()) {
+   token = it->second;
+   return;
+  }
+
+  auto entry = callee_symbols.find(name);
+  if (entry != callee_symbols.end()) {
+   if (entry->second.type == Parser::Type::Function || entry->second.attr_type != Parser::AttrType::Local) return;
+
+   Parser::TypeEntry local = entry->second;
+   symbols[name + suffix] = local;
+  }
+
+  token = renames[name] = make_name(name + suffix);
+ };
+
+ TACKY::Var end_label(make_name("inline_end" + suffix));
+ TACKY::Value &dst = call.dst;
+
+ for (size_t i = 0; i < callee.params.size(); i++) {
+  TACKY::Var param = callee.params[i];
+  rename(param.name);
+  body.push_back(TACKY::Copy(call.args[i], param));
+ }
+
+ for (size_t i = 0; i < callee.body.size(); i++) {
+  TACKY::Instruction inst = callee.body[i];
+  for_each_name(inst, rename);
+
+  TACKY::Return *ret = std::get_if<TACKY::Return>(&inst);
+  if (ret == nullptr) {
+   body.push_back(inst);
+   continue;
+  }
+
+  // The implicit "return 0" is an int whatever the return type; a copy
+  // takes its width from the source, so it must match the destination.
+  TACKY::Value val = ret->val;
+  TACKY::Constant *_const = std::get_if<TACKY::Constant>(&val);
+  if (_const != nullptr) _const->type = std::get<TACKY::Var>(dst).type;
+
+  body.push_back(TACKY::Copy(val, dst));
+  if (i + 1 < callee.body.size()) body.push_back(TACKY::Jump(end_label));
+ }
+
+ body.push_back(TACKY::Label(end_label));
+}
+
+// Internal functions that nothing reachable from main or an external
+// function calls any more are dropped.
+void LinkTimeOptimiser::remove_dead_functions() {
+ std::unordered_map<std::string, TACKY::Function *> funcs;
+ std::vector<std::string> work;
+ std::unordered_set<std::string> live;
+
+ for (TACKY::Function &func : program.funcs) {
+  std::string name = name_of(func.name);
+  funcs[name] = &func;
+
+  if (!is_internal(name)) {
+   live.insert(name);
+   work.push_back(name);
+  }
+ }
+
+ while (!work.empty()) {
+  auto it = funcs.find(work.back());
+  work.pop_back();
+  if (it == funcs.end()) continue;
+
+  for (TACKY::Instruction &inst : it->second->body) {
+   TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst);
+   if (call && live.insert(name_of(call->name)).second) {
+    work.push_back(name_of(call->name));
+   }
+  }
+ }
+
+ std::vector<TACKY::Function> kept;
+ for (TACKY::Function &func : program.funcs) {
+  std::string name = name_of(func.name);
+  if (!live.count(name)) {
+   OptRecord::remark(name, "remove-dead-functions", true, "removed: nothing reachable calls it");
+   continue;
+  }
+
+  if (internalise && name != "main") {
+   func.global = false;
+   symbols[name].global = false;
+  }
+
+  kept.push_back(std::move(func));
+ }
+
+ program.funcs = std::move(kept);
+
+ if (internalise) {
+  for (TACKY::StaticVariable &var : program.statics) {
+   var.global = false;
+  }
+ }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../tacky/types.h"
+#include "../tacky/util.h"
+#include "../parser/parser.h"
+#include "../helpers.h"
+
+// Assembly for an -flto object: just the serialised TACKY in LTO_SECTION.
+std::string lto_object(const std::string &tacky);
+
+// Callees at most this long are inlined into every caller.
+const size_t max_inline_size = 20;
+
+// Appends a copy of `callee`'s body in place of `call`. Entries for the
+// renamed locals are copied from `callee_symbols` into `symbols`.
+void inline_call(
+ std::vector<TACKY::Instruction> &body,
+ TACKY::FunCall &call,
+ TACKY::Function &callee,
+ Parser::SymbolTable &callee_symbols,
+ Parser::SymbolTable &symbols,
+ int &inline_count
+);
+
+// Merges the TACKY of every -flto object of a program and optimises across
+// them before code generation. Names without linkage are suffixed with their
+// module's index so that modules cannot clash.
+class LinkTimeOptimiser {
+ private:
+  TACKY::Program program;
+  Parser::SymbolTable symbols;
+  std::unordered_map<std::string, size_t> static_index;
+  bool internalise;
+  int inline_count;
+
+  void merge(TACKY::Program &module, Parser::SymbolTable &module_symbols, int index);
+  bool is_internal(std::string name);
+  void propagate_constant_args();
+  void inline_calls();
+  void remove_dead_functions();
+
+ public:
+  LinkTimeOptimiser() = delete;
+  // With `internalise`, the objects are the whole program: nothing outside
+  // them can call into it, so every function but main may be changed.
+  LinkTimeOptimiser(std::vector<std::string> objects, bool internalise);
+
+  TACKY::Program get_program();
+  Parser::SymbolTable &get_symbols();
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// -flto objects carry their serialised TACKY in this section instead of
+// code. It is marked SHF_EXCLUDE so that a linker never copies it out.
+#define LTO_SECTION ".c_compiler.tacky"
+
+// Maps a whole file read-only; returns nullptr if it cannot be read.
+inline const char *map_file(const std::string &path, size_t &size) {
+ int fd = open(path.c_str(), O_RDONLY);
+ if (fd < 0) return nullptr;
+
+ struct stat st;
+ void *map = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+ close(fd);
+ if (map == MAP_FAILED) return nullptr;
+
+ size = st.st_size;
+ return (const char *)map;
+}
+
+// Finds a section of a 64-bit ELF relocatable by name.
+inline bool find_section(const char *data, size_t size, const char *name, const char *&start, size_t &length) {
+ if (size < sizeof(Elf64_Ehdr) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64) {
+  return false;
+ }
+
+ const Elf64_Ehdr *header = (const Elf64_Ehdr *)data;
+ if (header->e_shentsize != sizeof(Elf64_Shdr) || header->e_shstrndx >= header->e_shnum ||
+     header->e_shoff + (uint64_t)header->e_shnum * sizeof(Elf64_Shdr) > size) {
+  return false;
+ }
+
+ const Elf64_Shdr *sections = (const Elf64_Shdr *)(data + header->e_shoff);
+ const Elf64_Shdr &names = sections[header->e_shstrndx];
+ if (names.sh_offset + names.sh_size > size) return false;
+
+ for (int i = 0; i < header->e_shnum; i++) {
+  const Elf64_Shdr &section = sections[i];
+  if (section.sh_name >= names.sh_size) continue;
+
+  const char *section_name = data + names.sh_offset + section.sh_name;
+  if (strnlen(section_name, names.sh_size - section.sh_name) != strlen(name) || strcmp(section_name, name) != 0) {
+   continue;
+  }
+
+  if (section.sh_offset + section.sh_size > size) return false;
+
+  start = data + section.sh_offset;
+  length = section.sh_size;
+  return true;
+ }
+
+ return false;
+}
+
+inline bool is_lto_object(const std::string &path) {
+ size_t size, length;
+ const char *start, *data = map_file(path, size);
+ if (data == nullptr) return false;
+
+ bool found = find_section(data, size, LTO_SECTION, start, length);
+ munmap((void *)data, size);
+
+ return found;
+}
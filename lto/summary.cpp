@@ -0,0 +1,347 @@
+#include <fstream>
+#include <cstring>
+#include <unordered_set>
+#include "summary.h"
+#include "lto.h"
+#include "object.h"
+#include "../tacky/serialise.h"
+#include "../helpers.h"
+#include "../opt_record.h"
+#include "../optimiser/budget.h"
+
+static const char summary_magic[4] = {'C', 'S', 'U', 'M'};
+static const uint32_t summary_version = 1;
+
+static bool is_static_var(Parser::SymbolTable &symbols, const std::string &name) {
+ auto it = symbols.find(name);
+ return it != symbols.end() && it->second.type != Parser::Type::Function && it->second.attr_type == Parser::AttrType::Static;
+}
+
+ModuleSummary::ModuleSummary(TACKY::Program &program, Parser::SymbolTable &symbols) {
+ std::unordered_map<std::string, size_t> index;
+
+ for (TACKY::Function &func : program.funcs) {
+  FunctionSummary summary;
+  summary.name = name_of(func.name);
+  summary.global = symbols[summary.name].global;
+  summary.size = func.body.size();
+
+  std::unordered_set<std::string> calls, reads, writes;
+  auto add = [&](std::vector<SymbolRef> &refs, std::unordered_set<std::string> &seen, std::string name) {
+   if (seen.insert(name).second) refs.push_back({name, symbols[name].global});
+  };
+
+  for (TACKY::Instruction &inst : func.body) {
+   if (TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst); call) {
+    add(summary.calls, calls, name_of(call->name));
+   }
+
+   // Reads are found by blanking the destination of a copy.
+   TACKY::Instruction sources = inst;
+   if (TACKY::Value *dst = get_dst(sources); dst) {
+    TACKY::Var *var = std::get_if<TACKY::Var>(dst);
+    if (var && is_static_var(symbols, name_of(var->name))) add(summary.writes, writes, name_of(var->name));
+    *dst = TACKY::Constant();
+   }
+
+   for_each_name(sources, [&](Token &name) {
+    if (is_static_var(symbols, name_of(name))) add(summary.reads, reads, name_of(name));
+   });
+  }
+
+  // Only functions that touch nothing private to this module can be
+  // compiled into another one.
+  bool private_refs = calls.count(summary.name) > 0;
+  for (auto *refs : {&summary.calls, &summary.reads, &summary.writes}) {
+   for (SymbolRef &ref : *refs) private_refs = private_refs || !ref.global;
+  }
+
+  summary.importable = summary.global && summary.size <= max_inline_size && !private_refs;
+  summary.pure = summary.writes.empty();
+
+  index[summary.name] = funcs.size();
+  funcs.push_back(summary);
+ }
+
+ // A function is pure if it writes no static storage and only calls pure
+ // functions; calls out of the module are assumed impure.
+ for (bool changed = true; changed;) {
+  changed = false;
+
+  for (FunctionSummary &func : funcs) {
+   if (!func.pure) continue;
+
+   for (SymbolRef &call : func.calls) {
+    auto it = index.find(call.name);
+    if (it != index.end() && funcs[it->second].pure) continue;
+
+    func.pure = false;
+    changed = true;
+    break;
+   }
+  }
+ }
+
+ for (TACKY::Function &func : program.funcs) {
+  if (!funcs[index[name_of(func.name)]].importable) continue;
+
+  bodies.funcs.push_back(func);
+  for (TACKY::Var &param : func.params) {
+   body_symbols[name_of(param.name)] = symbols[name_of(param.name)];
+  }
+
+  for (TACKY::Instruction &inst : func.body) {
+   for_each_name(inst, [&](Token &token) {
+    auto it = symbols.find(name_of(token));
+    if (it != symbols.end()) body_symbols[it->first] = it->second;
+   });
+  }
+ }
+}
+
+// Layout: magic, version, the function summaries and then the importable
+// bodies as a serialised TACKY program.
+bool ModuleSummary::save(std::string path) {
+ std::string out;
+ auto put = [&](uint64_t num, size_t size) {out.append((const char *)&num, size);};
+ auto put_str = [&](const std::string &str) {put(str.size(), 4); out += str;};
+ auto put_refs = [&](std::vector<SymbolRef> &refs) {
+  put(refs.size(), 4);
+  for (SymbolRef &ref : refs) {
+   put_str(ref.name);
+   put(ref.global, 1);
+  }
+ };
+
+ out.append(summary_magic, 4);
+ put(summary_version, 4);
+ put(funcs.size(), 4);
+ for (FunctionSummary &func : funcs) {
+  put_str(func.name);
+  put(func.global | func.pure << 1 | func.importable << 2, 1);
+  put(func.size, 4);
+  put_refs(func.calls);
+  put_refs(func.reads);
+  put_refs(func.writes);
+ }
+
+ std::string tacky = TACKY::serialise(bodies, body_symbols);
+ put(tacky.size(), 8);
+ out += tacky;
+
+ std::ofstream file(path, std::ios::binary);
+ file << out;
+ file.close();
+
+ return (bool)file;
+}
+
+bool ModuleSummary::load(std::string path) {
+ size_t size;
+ const char *curr = map_file(path, size);
+ if (curr == nullptr) return false;
+
+ const char *end = curr + size;
+ bool ok = true;
+ auto get = [&](size_t size) -> uint64_t {
+  uint64_t num = 0;
+  ok = ok && (size_t)(end - curr) >= size;
+  if (ok) memcpy(&num, curr, size);
+  curr += ok ? size : 0;
+  return num;
+ };
+ auto get_bytes = [&](size_t length) -> const char * {
+  const char *bytes = curr;
+  ok = ok && (size_t)(end - curr) >= length;
+  curr += ok ? length : 0;
+  return bytes;
+ };
+ auto get_str = [&]() -> std::string {
+  size_t length = get(4);
+  const char *str = get_bytes(length);
+  return ok ? std::string(str, length) : "";
+ };
+ auto get_refs = [&](std::vector<SymbolRef> &refs) {
+  size_t num_refs = get(4);
+  for (size_t i = 0; ok && i < num_refs; i++) {
+   std::string name = get_str();
+   refs.push_back({name, get(1) != 0});
+  }
+ };
+
+ if (memcmp(get_bytes(4), summary_magic, 4) != 0 || get(4) != summary_version) return false;
+
+ size_t num_funcs = get(4);
+ for (size_t i = 0; ok && i < num_funcs; i++) {
+  FunctionSummary func;
+  func.name = get_str();
+  int flags = get(1);
+  func.global = (flags & 1) != 0;
+  func.pure = (flags & 2) != 0;
+  func.importable = (flags & 4) != 0;
+  func.size = get(4);
+  get_refs(func.calls);
+  get_refs(func.reads);
+  get_refs(func.writes);
+
+  funcs.push_back(func);
+ }
+
+ size_t length = get(8);
+ const char *tacky = get_bytes(length);
+
+ return ok && TACKY::deserialise(tacky, length, bodies, body_symbols);
+}
+
+CrossModuleOptimiser::CrossModuleOptimiser(
+ TACKY::Program program,
+ Parser::SymbolTable &symbols,
+ std::vector<std::string> summaries,
+ bool internalise
+) {
+ this->program = program;
+ this->symbols = &symbols;
+ this->internalise = internalise;
+ inline_count = 0;
+
+ for (std::string &path : summaries) {
+  ModuleSummary module;
+  if (!module.load(path)) error("Could not read summary " + path);
+
+  modules.push_back(std::move(module));
+ }
+
+ // This module's own summary goes last and is taken before anything is
+ // imported, so the call graph is the same one every module sees.
+ modules.push_back(ModuleSummary(this->program, symbols));
+
+ import_functions();
+ OptRecord::pass("import", this->program);
+ if (internalise) {
+  internalise_functions();
+  OptRecord::pass("internalise", this->program);
+ }
+}
+
+TACKY::Program CrossModuleOptimiser::get_program() {
+ return program;
+}
+
+void CrossModuleOptimiser::import_functions() {
+ struct Import {
+  TACKY::Function *func;
+  ModuleSummary *module;
+ };
+
+ std::unordered_map<std::string, Import> imports;
+ for (size_t m = 0; m + 1 < modules.size(); m++) {
+  for (TACKY::Function &func : modules[m].bodies.funcs) {
+   imports.emplace(name_of(func.name), Import{&func, &modules[m]});
+  }
+ }
+
+ for (TACKY::Function &func : program.funcs) {
+  if (Optimiser::tier(func, "import") != Optimiser::Tier::Full) continue;
+
+  std::vector<TACKY::Instruction> body;
+  body.reserve(func.body.size());
+
+  for (TACKY::Instruction &inst : func.body) {
+   TACKY::FunCall *call = std::get_if<TACKY::FunCall>(&inst);
+   auto it = call ? imports.find(name_of(call->name)) : imports.end();
+   auto entry = call ? symbols->find(name_of(call->name)) : symbols->end();
+
+   if (it == imports.end() || (entry != symbols->end() && entry->second.defined) ||
+       it->second.func->params.size() != call->args.size()) {
+    if (it != imports.end() && (entry == symbols->end() || !entry->second.defined)) {
+     OptRecord::remark(name_of(func.name), "import", false, "not importing " + it->first + ": wrong number of arguments");
+    }
+
+    body.push_back(inst);
+    continue;
+   }
+
+   // Globals the imported body uses become extern declarations here.
+   Parser::SymbolTable &callee_symbols = it->second.module->body_symbols;
+   for (TACKY::Instruction &callee_inst : it->second.func->body) {
+    for_each_name(callee_inst, [&](Token &token) {
+     std::string name = name_of(token);
+     auto ref = callee_symbols.find(name);
+     if (symbols->count(name) || ref == callee_symbols.end() || !ref->second.global) return;
+
+     Parser::TypeEntry decl = ref->second;
+     decl.defined = false;
+     if (decl.type != Parser::Type::Function) decl.init_val_type = Parser::InitValType::None;
+     (*symbols)[name] = decl;
+    });
+   }
+
+   OptRecord::remark(name_of(func.name), "import", true, "imported and inlined " + it->first);
+   inline_call(body, *call, *it->second.func, callee_symbols, *symbols, inline_count);
+  }
+
+  func.body = std::move(body);
+ }
+}
+
+// Functions are keyed by name, or by module and name if they have no
+// linkage. Those main cannot reach are dropped, and those only this module
+// calls, from functions no other module can import, stop being exported.
+void CrossModuleOptimiser::internalise_functions() {
+ auto key = [](size_t module, SymbolRef ref) {
+  return ref.global ? ref.name : std::to_string(module) + ":" + ref.name;
+ };
+
+ std::unordered_map<std::string, std::vector<std::string>> edges;
+ std::unordered_set<std::string> called_elsewhere;
+ size_t self = modules.size() - 1;
+
+ for (size_t m = 0; m < modules.size(); m++) {
+  for (FunctionSummary &func : modules[m].funcs) {
+   std::vector<std::string> &out = edges[key(m, {func.name, func.global})];
+
+   // An importable function's calls go wherever its body is inlined, this
+   // module's own included.
+   for (SymbolRef &call : func.calls) {
+    out.push_back(key(m, call));
+    if ((m != self || func.importable) && call.global) called_elsewhere.insert(call.name);
+   }
+  }
+ }
+
+ std::unordered_set<std::string> live = {"main"};
+ std::vector<std::string> work = {"main"};
+ while (!work.empty()) {
+  std::string name = work.back();
+  work.pop_back();
+
+  for (std::string &callee : edges[name]) {
+   if (live.insert(callee).second) work.push_back(callee);
+  }
+ }
+
+ std::vector<TACKY::Function> kept;
+ for (TACKY::Function &func : program.funcs) {
+  std::string name = name_of(func.name);
+  Parser::TypeEntry &entry = (*symbols)[name];
+  if (name == "main") {
+   kept.push_back(std::move(func));
+   continue;
+  }
+
+  if (!live.count(key(self, {name, entry.global}))) {
+   OptRecord::remark(name, "internalise", true, "removed: main cannot reach it");
+   continue;
+  }
+
+  if (entry.global && !called_elsewhere.count(name)) {
+   OptRecord::remark(name, "internalise", true, "made local: no other module calls it");
+   entry.global = false;
+   func.global = false;
+  }
+
+  kept.push_back(std::move(func));
+ }
+
+ program.funcs = std::move(kept);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../tacky/types.h"
+#include "../parser/parser.h"
+
+struct SymbolRef {
+ std::string name;
+ bool global;
+};
+
+struct FunctionSummary {
+ std::string name;
+ bool global, pure, importable;
+ size_t size;
+ std::vector<SymbolRef> calls, reads, writes;
+};
+
+// What other modules need to know about a translation unit without loading
+// its IR: the call graph, sizes, purity and static storage each function
+// touches, plus the bodies of small functions that callers may import.
+class ModuleSummary {
+ public:
+  std::vector<FunctionSummary> funcs;
+  TACKY::Program bodies;
+  Parser::SymbolTable body_symbols;
+
+  ModuleSummary() {}
+  ModuleSummary(TACKY::Program &program, Parser::SymbolTable &symbols);
+
+  bool save(std::string path);
+  // The file stays mapped: imported bodies point into it.
+  bool load(std::string path);
+};
+
+// Uses the summaries of the other modules of a program to import small
+// functions they define, internalise functions no other module calls and
+// drop functions main can never reach. The latter two need `internalise`:
+// the summaries must then cover the whole program.
+class CrossModuleOptimiser {
+ private:
+  TACKY::Program program;
+  Parser::SymbolTable *symbols;
+  std::vector<ModuleSummary> modules;
+  bool internalise;
+  int inline_count;
+
+  void import_functions();
+  void internalise_functions();
+
+ public:
+  CrossModuleOptimiser() = delete;
+  CrossModuleOptimiser(TACKY::Program program, Parser::SymbolTable &symbols, std::vector<std::string> summaries, bool internalise);
+
+  TACKY::Program get_program();
+};
@@ -1,13 +1,31 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <optional>
 #include "lexer/lexer.h"
 #include "parser/parser.h"
+#include "parser/snapshot.h"
 #include "tacky/tacky.h"
+#include "tacky/serialise.h"
 #include "code_gen/code_gen.h"
 #include "emitter.h"
+#include "function_cache.h"
+#include "lto/lto.h"
+#include "lto/summary.h"
+#include "optimiser/pass_manager.h"
 #include "helpers.h"
+#include "trace.h"
+#include "mem_report.h"
+#include "perf_counters.h"
+#include "opt_record.h"
 
 string readFile(const char* filePath) {
+ if (string(filePath) == "-") {
+  std::stringstream buf;
+  buf << std::cin.rdbuf();
+  return buf.str();
+ }
+
  std::ifstream ifs(filePath, std::ios::in | std::ios::binary | std::ios::ate);
 
  std::ifstream::pos_type fileSize = ifs.tellg();
@@ -17,11 +35,122 @@ string readFile(const char* filePath) {
  return string(bytes.data(), fileSize);
 }
 
+int write_output(string out_path, string code) {
+ Trace::Scope scope("Write output");
+ if (out_path == "-") {
+  std::cout << code;
+  return 0;
+ }
+
+ std::ofstream prog;
+ prog.open(out_path);
+
+ prog << code;
+
+ prog.close();
+
+ return 0;
+}
+
+// -fmem-report sizes of what each stage leaves behind.
+void report_tacky(TACKY::Program &program, Parser::SymbolTable &symbols) {
+ if (!MemReport::enabled) return;
+
+ size_t count = 0, bytes = 0;
+ for (TACKY::Function &func : program.funcs) {
+  MemReport::function("TACKY instructions", func.name, func.body.size(), MemReport::bytes(func.body));
+  count += func.body.size();
+  bytes += MemReport::bytes(func.body);
+ }
+
+ MemReport::structure("SymbolTable entries", symbols.size(), MemReport::bytes(symbols));
+ MemReport::structure("TACKY instructions", count, bytes);
+}
+
+void report_gen(Generator &gen) {
+ if (!MemReport::enabled) return;
+
+ size_t count = 0, bytes = 0;
+ for (Gen::Function &func : gen.get_program().funcs) {
+  MemReport::function("Gen::Instructions", func.name, func.instructions.size(), MemReport::bytes(func.instructions));
+  count += func.instructions.size();
+  bytes += MemReport::bytes(func.instructions);
+ }
+
+ MemReport::structure("Gen::Instructions", count, bytes);
+}
+
+void report_code(string &code) {
+ if (MemReport::enabled) MemReport::structure("Emitter buffer", code.size(), code.capacity());
+}
+
+// Runs the -O/--passes pipeline between TACKY and code generation.
+void optimise(TACKY::Program &program, Parser::SymbolTable &symbols, string pipeline, bool time_passes) {
+ if (pipeline == "") return;
+
+ Trace::Scope scope("Optimiser");
+ Optimiser::PassManager(pipeline, time_passes).run(program, symbols);
+}
+
 int main(int argc, char* argv[]) {
  int mode = 100;
+ string function_cache_dir, cache_flags, snapshot_in, snapshot_out, tacky_out, summary_out, pipeline;
+ std::vector<string> summaries;
+ bool from_tacky = false, lto = false, internalise = false, time_passes = false;
+
+ // -O<level> and --passes= anywhere on the command line; the last one wins.
+ auto pipeline_flag = [&](const string &flag) {
+  if (flag.substr(0, 9) == "--passes=") pipeline = flag.substr(9);
+  else if (flag == "-O") pipeline = Optimiser::PassManager::pipeline_for(1);
+  else if (flag.size() == 3 && flag.substr(0, 2) == "-O" && isdigit(flag[2])) pipeline = Optimiser::PassManager::pipeline_for(flag[2] - '0');
+  else if (flag == "--time-passes") time_passes = true;
+  else return false;
 
- if (argc > 3 && argv[3][0] == '-') {
-  string flag = argv[3];
+  return true;
+ };
+
+ // compiler --lto <output> <object>...: link-time optimisation of the TACKY
+ // carried by -flto objects.
+ if (argc > 2 && string(argv[1]) == "--lto") {
+  std::vector<string> objects;
+  bool internalise = false;
+  for (int i = 3; i < argc; i++) {
+   string arg = argv[i];
+   if (arg == "--internalise") {
+    internalise = true;
+   } else if (arg.substr(0, 13) == "-ftime-trace=") {
+    Trace::start(arg.substr(13));
+   } else if (arg == "-fmem-report" || arg.substr(0, 13) == "-fmem-report=") {
+    MemReport::start(arg.size() > 13 ? arg.substr(13) : "");
+   } else if (arg == "--perf-counters") {
+    PerfCounters::start();
+   } else if (arg.substr(0, 27) == "-fsave-optimization-record=") {
+    OptRecord::start(arg.substr(27));
+   } else if (!Optimiser::parse_limit(arg) && !pipeline_flag(arg) && arg[0] != '-') {
+    objects.push_back(arg);
+   }
+  }
+
+  Trace::begin("LinkTimeOptimiser");
+  LinkTimeOptimiser optimiser(objects, internalise);
+  Trace::end();
+  TACKY::Program program = optimiser.get_program();
+  optimise(program, optimiser.get_symbols(), pipeline, time_passes);
+  Trace::begin("Generator");
+  Generator gen(program, optimiser.get_symbols());
+  Trace::end();
+  report_gen(gen);
+  Trace::begin("Emitter");
+  Emitter emitter(gen);
+  Trace::end();
+
+  string code = emitter.get_code();
+  report_code(code);
+  return write_output(argv[2], code);
+ }
+
+ for (int i = 3; i < argc && argv[i][0] == '-'; i++) {
+  string flag = argv[i];
 
   if (flag == "--lex") {
    mode = 1;
@@ -33,29 +162,144 @@ int main(int argc, char* argv[]) {
    mode = 4;
   } else if (flag == "--codegen") {
    mode = 5;
+  } else if (flag.substr(0, 17) == "--function-cache=") {
+   function_cache_dir = flag.substr(17);
+   continue;
+  } else if (flag.substr(0, 13) == "--emit-tacky=") {
+   tacky_out = flag.substr(13);
+   continue;
+  } else if (flag == "-flto") {
+   lto = true;
+  } else if (flag.substr(0, 15) == "--emit-summary=") {
+   summary_out = flag.substr(15);
+   continue;
+  } else if (flag.substr(0, 19) == "--import-summaries=") {
+   std::stringstream paths(flag.substr(19));
+   for (string path; std::getline(paths, path, ',');) {
+    if (path != "") summaries.push_back(path);
+   }
+  } else if (flag == "--internalise") {
+   internalise = true;
+  } else if (flag.substr(0, 13) == "-ftime-trace=") {
+   Trace::start(flag.substr(13));
+   continue;
+  } else if (flag == "-fmem-report" || flag.substr(0, 13) == "-fmem-report=") {
+   MemReport::start(flag.size() > 13 ? flag.substr(13) : "");
+   continue;
+  } else if (flag == "--perf-counters") {
+   PerfCounters::start();
+   continue;
+  } else if (flag.substr(0, 27) == "-fsave-optimization-record=") {
+   OptRecord::start(flag.substr(27));
+   continue;
+  } else if (Optimiser::parse_limit(flag) || pipeline_flag(flag)) {
+   // These change the code, so they stay in the cache key.
+  } else if (flag == "--from-tacky") {
+   from_tacky = true;
+  } else if (flag.substr(0, 16) == "--decl-snapshot=") {
+   snapshot_in = flag.substr(16);
+   continue;
+  } else if (flag.substr(0, 21) == "--emit-decl-snapshot=") {
+   snapshot_out = flag.substr(21);
+   continue;
+  }
+
+  cache_flags += flag + ' ';
+ }
+
+ TACKY::Program program;
+ Parser::SymbolTable symbols;
+ if (from_tacky) {
+  Trace::begin("Load TACKY");
+  if (!TACKY::load(argv[1], program, symbols)) {
+   error("Could not load TACKY from " + string(argv[1]));
   }
+  Trace::end();
+
+  OptRecord::pass("from-tacky", program);
+  optimise(program, symbols, pipeline, time_passes);
+  report_tacky(program, symbols);
+  Trace::begin("Generator");
+  Generator gen(program, symbols);
+  Trace::end();
+  report_gen(gen);
+  if (mode == 5) return 0;
+  Trace::begin("Emitter");
+  Emitter emitter(gen);
+  Trace::end();
+
+  string code = emitter.get_code();
+  report_code(code);
+  return write_output(argc > 2 ? argv[2] : "out.s", code);
  }
 
+ Trace::begin("Read source");
  string src = readFile(argv[1]);
+ Trace::end();
+
+ // A snapshot that does not match the source is ignored.
+ Parser::DeclSnapshot snapshot;
+ if (snapshot_in != "") {
+  Trace::Scope scope("Load declaration snapshot");
+  snapshot.load(snapshot_in, src);
+ }
 
- Lexer lexer(src);
+ Trace::begin("Lexer");
+ Lexer lexer(src, snapshot.prefix_bytes, snapshot.prefix_line);
+ Trace::end();
+ if (MemReport::enabled) MemReport::structure("Token vector", lexer.tokens.size(), MemReport::bytes(lexer.tokens));
  if (mode == 1) return 0;
- Parser::CParser parser(lexer, mode >= 3);
+ Trace::begin("CParser");
+ Parser::CParser parser(lexer, mode >= 3, snapshot_in != "" || snapshot_out != "" ? &snapshot : nullptr);
+ Trace::end();
+ if (snapshot_out != "" && mode >= 3 && !snapshot.loaded) {
+  Trace::Scope scope("Save declaration snapshot");
+  snapshot.save(snapshot_out, src);
+ }
  if (mode == 2 || mode == 3) return 0;
- TACKYifier tackyifier(parser);
- if (mode == 4) return 0;
- Generator gen(tackyifier);
- if (mode == 5) return 0;
- Emitter emitter(gen);
 
- std::ofstream prog;
- if (argc > 1) {
-  prog.open(argv[2]);
- } else prog.open("out.s");
+ // Functions found in the cache are never lowered, so saved TACKY or a
+ // summary would be missing them, and imports could not change them.
+ std::optional<FunctionCache> cache;
+ std::unordered_set<string> cached;
+ if (function_cache_dir != "" && tacky_out == "" && summary_out == "" && summaries.empty() && !lto) {
+  Trace::Scope scope("FunctionCache lookup");
+  cache.emplace(function_cache_dir, cache_flags);
+  cached = cache->lookup(lexer, parser);
+ }
 
- prog << emitter.get_code();
+ Trace::begin("TACKYifier");
+ TACKYifier tackyifier(parser, cached);
+ Trace::end();
+ OptRecord::pass("TACKYifier", tackyifier.program);
+ if (tacky_out != "" && !TACKY::save(tacky_out, tackyifier.program, parser.symbols)) {
+  error("Could not write TACKY to " + tacky_out);
+ }
+ if (summary_out != "" && !ModuleSummary(tackyifier.program, parser.symbols).save(summary_out)) {
+  error("Could not write summary to " + summary_out);
+ }
+ if (mode == 4) return 0;
+ if (lto) {
+  return write_output(argc > 2 ? argv[2] : "out.s", lto_object(TACKY::serialise(tackyifier.program, parser.symbols)));
+ }
 
- prog.close();
+ TACKY::Program tacky_program = tackyifier.get_program();
+ if (!summaries.empty() || internalise) {
+  Trace::Scope scope("CrossModuleOptimiser");
+  tacky_program = CrossModuleOptimiser(tacky_program, parser.symbols, summaries, internalise).get_program();
+ }
+ optimise(tacky_program, parser.symbols, pipeline, time_passes);
+ report_tacky(tacky_program, parser.symbols);
+ Trace::begin("Generator");
+ Generator gen(tacky_program, parser.symbols);
+ Trace::end();
+ report_gen(gen);
+ if (mode == 5) return 0;
+ Trace::begin("Emitter");
+ Emitter emitter(gen, cache ? &*cache : nullptr);
+ Trace::end();
 
- return 0;
+ string code = emitter.get_code();
+ report_code(code);
+ return write_output(argc > 2 ? argv[2] : "out.s", code);
 }
\ No newline at end of file
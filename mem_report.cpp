@@ -0,0 +1,281 @@
+#include <new>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <malloc.h>
+#include "mem_report.h"
+#include "trace.h"
+
+bool MemReport::enabled = false;
+
+static uint64_t allocated_bytes = 0, allocations = 0;
+static int64_t live_bytes = 0;
+// Set while the report's own bookkeeping allocates.
+static bool paused = false;
+
+// Only the compiler's own thread allocates, so plain counters do.
+void *operator new(size_t size) {
+ void *ptr = malloc(size ? size : 1);
+ if (ptr == nullptr) throw std::bad_alloc();
+
+ if (MemReport::enabled && !paused) {
+  allocated_bytes += size;
+  allocations++;
+  live_bytes += malloc_usable_size(ptr);
+ }
+
+ return ptr;
+}
+
+void *operator new[](size_t size) {
+ return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+ if (MemReport::enabled && !paused && ptr != nullptr) live_bytes -= malloc_usable_size(ptr);
+ free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+ operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+ operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+ operator delete(ptr);
+}
+
+struct PhaseStats {
+ const char *name;
+ size_t depth;
+ uint64_t bytes, count;
+ int64_t retained;
+ size_t peak_rss;
+};
+
+struct StructureStats {
+ std::string name;
+ size_t count, bytes;
+};
+
+struct FunctionStats {
+ std::string structure, name;
+ size_t count, bytes;
+};
+
+static std::vector<PhaseStats> phases;
+static std::vector<StructureStats> structures;
+static std::vector<FunctionStats> functions;
+static std::string report_path;
+
+// VmHWM or VmRSS from /proc/self/status, in bytes.
+static size_t read_status(const char *field) {
+ FILE *status = fopen("/proc/self/status", "r");
+ if (status == nullptr) return 0;
+
+ char line[256];
+ size_t kb = 0, length = strlen(field);
+ while (fgets(line, sizeof(line), status)) {
+  if (strncmp(line, field, length) == 0 && line[length] == ':') {
+   kb = strtoull(line + length + 1, nullptr, 10);
+   break;
+  }
+ }
+
+ fclose(status);
+ return kb * 1024;
+}
+
+// Writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+), so
+// each phase sees its own peak. Open phases take the high-water mark before
+// a nested phase resets it.
+class PhaseObserver : public Trace::Observer {
+ private:
+  struct Open {
+   size_t index;
+   uint64_t bytes, count;
+   int64_t live;
+  };
+
+  std::vector<Open> open;
+
+  void sample_peak() {
+   size_t peak = read_status("VmHWM");
+   for (Open &phase : open) {
+    phases[phase.index].peak_rss = std::max(phases[phase.index].peak_rss, peak);
+   }
+  }
+
+  void reset_peak() {
+   FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+   if (clear_refs == nullptr) return;
+
+   fputs("5", clear_refs);
+   fclose(clear_refs);
+  }
+
+ public:
+  void phase_begin(const char *name) override {
+   paused = true;
+   sample_peak();
+   reset_peak();
+
+   open.push_back({phases.size(), allocated_bytes, allocations, live_bytes});
+   phases.push_back({name, open.size() - 1, 0, 0, 0, read_status("VmRSS")});
+   paused = false;
+  }
+
+  void phase_end(const char *) override {
+   if (open.empty()) return;
+
+   paused = true;
+   sample_peak();
+   Open phase = open.back();
+   open.pop_back();
+
+   PhaseStats &stats = phases[phase.index];
+   stats.bytes = allocated_bytes - phase.bytes;
+   stats.count = allocations - phase.count;
+   stats.retained = live_bytes - phase.live;
+   paused = false;
+  }
+};
+
+static PhaseObserver observer;
+
+static std::string format_bytes(double bytes) {
+ const char *units[] = {"B", "KiB", "MiB", "GiB"};
+ int unit = 0;
+ bool negative = bytes < 0;
+ if (negative) bytes = -bytes;
+ while (bytes >= 1024 && unit < 3) {
+  bytes /= 1024;
+  unit++;
+ }
+
+ char buf[32];
+ snprintf(buf, sizeof(buf), unit ? "%s%.1f %s" : "%s%.0f %s", negative ? "-" : "", bytes, units[unit]);
+ return buf;
+}
+
+static std::string json_string(const std::string &str) {
+ std::string out = "\"";
+ for (char c : str) {
+  if (c == '"' || c == '\\') out += '\\';
+  out += c;
+ }
+
+ return out + '"';
+}
+
+// The AST is whatever the Parse phase allocated and kept.
+static void add_ast_structure() {
+ for (PhaseStats &phase : phases) {
+  if (std::string(phase.name) == "Parse") {
+   structures.insert(structures.begin(), {"AST (parse allocations)", phase.count, (size_t)std::max<int64_t>(phase.retained, 0)});
+   return;
+  }
+ }
+}
+
+static void print_table() {
+ fprintf(stderr, "%-36s %12s %10s %12s %12s\n", "Phase", "Allocated", "Allocs", "Retained", "Peak RSS");
+ for (PhaseStats &phase : phases) {
+  std::string name = std::string(phase.depth * 2, ' ') + phase.name;
+  fprintf(
+   stderr, "%-36s %12s %10llu %12s %12s\n",
+   name.c_str(),
+   format_bytes(phase.bytes).c_str(),
+   (unsigned long long)phase.count,
+   format_bytes(phase.retained).c_str(),
+   format_bytes(phase.peak_rss).c_str()
+  );
+ }
+
+ fprintf(stderr, "\n%-36s %12s %12s\n", "Structure", "Count", "Bytes");
+ for (StructureStats &structure : structures) {
+  fprintf(stderr, "%-36s %12zu %12s\n", structure.name.c_str(), structure.count, format_bytes(structure.bytes).c_str());
+ }
+
+ // Only the largest functions of each structure; the JSON has them all.
+ std::vector<FunctionStats> largest = functions;
+ std::stable_sort(largest.begin(), largest.end(), [](const FunctionStats &a, const FunctionStats &b) {
+  return a.structure != b.structure ? a.structure < b.structure : a.bytes > b.bytes;
+ });
+
+ std::string structure;
+ int shown = 0;
+ for (FunctionStats &func : largest) {
+  if (func.structure != structure) {
+   structure = func.structure;
+   shown = 0;
+   fprintf(stderr, "\n%-36s %12s %12s\n", (structure + " (largest)").c_str(), "Count", "Bytes");
+  }
+
+  if (shown++ < 10) {
+   fprintf(stderr, "%-36s %12zu %12s\n", func.name.c_str(), func.count, format_bytes(func.bytes).c_str());
+  }
+ }
+}
+
+static void write_json() {
+ std::ofstream out(report_path);
+ out << "{\"phases\":[";
+ for (size_t i = 0; i < phases.size(); i++) {
+  PhaseStats &phase = phases[i];
+  out << (i ? "," : "") << "\n{\"name\":" << json_string(phase.name) << ",\"depth\":" << phase.depth
+      << ",\"allocated\":" << phase.bytes << ",\"allocations\":" << phase.count
+      << ",\"retained\":" << phase.retained << ",\"peak_rss\":" << phase.peak_rss << "}";
+ }
+
+ out << "],\"structures\":[";
+ for (size_t i = 0; i < structures.size(); i++) {
+  StructureStats &structure = structures[i];
+  out << (i ? "," : "") << "\n{\"name\":" << json_string(structure.name)
+      << ",\"count\":" << structure.count << ",\"bytes\":" << structure.bytes << "}";
+ }
+
+ out << "],\"functions\":[";
+ for (size_t i = 0; i < functions.size(); i++) {
+  FunctionStats &func = functions[i];
+  out << (i ? "," : "") << "\n{\"structure\":" << json_string(func.structure) << ",\"name\":" << json_string(func.name)
+      << ",\"count\":" << func.count << ",\"bytes\":" << func.bytes << "}";
+ }
+
+ out << "]}\n";
+}
+
+static void write_report() {
+ MemReport::enabled = false;
+ add_ast_structure();
+
+ if (report_path == "") print_table();
+ else write_json();
+}
+
+void MemReport::start(std::string path) {
+ if (enabled) return;
+
+ enabled = true;
+ report_path = path;
+ Trace::observe(&observer);
+ atexit(write_report);
+}
+
+void MemReport::structure(std::string name, size_t count, size_t bytes) {
+ paused = true;
+ structures.push_back({name, count, bytes});
+ paused = false;
+}
+
+void MemReport::function(std::string structure, Token name, size_t count, size_t bytes) {
+ paused = true;
+ functions.push_back({structure, name.to_string(), count, bytes});
+ paused = false;
+}
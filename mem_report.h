@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "lexer/tokens.h"
+
+// -fmem-report: heap allocations and peak RSS for each phase, plus the sizes
+// of the compiler's main data structures. Allocations are counted by the
+// replacement operator new in mem_report.cpp, so only C++ allocations show
+// up; the phases are the Trace ones.
+namespace MemReport {
+ extern bool enabled;
+
+ // Prints a table on stderr at exit, or writes JSON to `path` if given.
+ void start(std::string path);
+ void structure(std::string name, size_t count, size_t bytes);
+ // One entry per function for a per-function structure, e.g. TACKY.
+ void function(std::string structure, Token name, size_t count, size_t bytes);
+
+ // Shallow sizes: only the storage the container itself owns.
+ template<class T>
+ size_t bytes(const std::vector<T> &vec) {
+  return vec.capacity() * sizeof(T);
+ }
+
+ template<class K, class V>
+ size_t bytes(const std::unordered_map<K, V> &map) {
+  // Each node holds the pair, a next pointer and the cached hash.
+  return map.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void *)) + map.bucket_count() * sizeof(void *);
+ }
+}
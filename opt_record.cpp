@@ -0,0 +1,115 @@
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <unordered_map>
+#include "opt_record.h"
+
+struct PassCount {
+ const char *pass;
+ size_t instructions;
+};
+
+struct Remark {
+ const char *pass;
+ bool applied;
+ std::string message;
+};
+
+struct FunctionRecord {
+ std::string name;
+ std::vector<PassCount> passes;
+ std::vector<Remark> remarks;
+ bool generated = false;
+ OptRecord::CodegenStats stats;
+};
+
+bool OptRecord::enabled = false;
+
+static std::string record_path;
+static std::vector<FunctionRecord> records;
+static std::unordered_map<std::string, size_t> record_index;
+
+static FunctionRecord &record(const std::string &function) {
+ auto it = record_index.find(function);
+ if (it != record_index.end()) return records[it->second];
+
+ record_index[function] = records.size();
+ records.push_back({function});
+ return records.back();
+}
+
+static std::string json_string(const std::string &str) {
+ std::string out = "\"";
+ for (char c : str) {
+  if (c == '"' || c == '\\') out += '\\';
+  out += c;
+ }
+
+ return out + '"';
+}
+
+// One record per line, so that two versions of the compiler can be diffed.
+static void write_records() {
+ std::ofstream out(record_path);
+ out << "[";
+
+ for (size_t i = 0; i < records.size(); i++) {
+  FunctionRecord &func = records[i];
+  out << (i ? "," : "") << "\n{\"function\":" << json_string(func.name) << ",\"passes\":[";
+  for (size_t p = 0; p < func.passes.size(); p++) {
+   out << (p ? "," : "") << "{\"pass\":" << json_string(func.passes[p].pass)
+       << ",\"instructions\":" << func.passes[p].instructions << "}";
+  }
+
+  out << "]";
+  if (func.generated) {
+   OptRecord::CodegenStats &stats = func.stats;
+   out << ",\"temporaries\":" << stats.temporaries << ",\"spills\":" << stats.spills
+       << ",\"frame_size\":" << stats.frame_size << ",\"bounce_moves\":" << stats.bounce_moves
+       << ",\"calls\":" << stats.calls;
+  }
+
+  out << ",\"remarks\":[";
+  for (size_t r = 0; r < func.remarks.size(); r++) {
+   Remark &remark = func.remarks[r];
+   out << (r ? "," : "") << "{\"pass\":" << json_string(remark.pass) << ",\"status\":\""
+       << (remark.applied ? "applied" : "rejected") << "\",\"message\":" << json_string(remark.message) << "}";
+  }
+
+  out << "]}";
+ }
+
+ out << "\n]\n";
+}
+
+void OptRecord::start(std::string path) {
+ if (enabled) return;
+
+ enabled = true;
+ record_path = path;
+ atexit(write_records);
+}
+
+void OptRecord::pass(const char *pass, TACKY::Program &program) {
+ if (!enabled) return;
+
+ for (TACKY::Function &func : program.funcs) {
+  record(func.name.to_string()).passes.push_back({pass, func.body.size()});
+ }
+}
+
+void OptRecord::pass(const char *pass, std::string function, size_t instructions) {
+ if (enabled) record(function).passes.push_back({pass, instructions});
+}
+
+void OptRecord::remark(std::string function, const char *pass, bool applied, std::string message) {
+ if (enabled) record(function).remarks.push_back({pass, applied, message});
+}
+
+void OptRecord::codegen(std::string function, CodegenStats stats) {
+ if (!enabled) return;
+
+ FunctionRecord &func = record(function);
+ func.generated = true;
+ func.stats = stats;
+}
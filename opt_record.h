@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include "tacky/types.h"
+
+// -fsave-optimization-record=<file>: one JSON record per function with its
+// TACKY instruction count after each pass, the transformations that fired or
+// were turned down (and why), and code generation statistics. Nothing is
+// recorded unless `enabled`; messages that take work to build are only built
+// when it is set.
+namespace OptRecord {
+ extern bool enabled;
+
+ void start(std::string path);
+ // Records the instruction count of every function in `program` after `pass`.
+ void pass(const char *pass, TACKY::Program &program);
+ void pass(const char *pass, std::string function, size_t instructions);
+ void remark(std::string function, const char *pass, bool applied, std::string message);
+
+ struct CodegenStats {
+  // Pseudos are TACKYifier temporaries plus named locals; with no register
+  // allocator every one of them is spilled to its own stack slot.
+  size_t temporaries, spills, frame_size;
+  // Moves through R10/R11 that fix up operands x86 does not allow.
+  size_t bounce_moves;
+  size_t calls;
+ };
+
+ void codegen(std::string function, CodegenStats stats);
+}
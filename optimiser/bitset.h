@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Optimiser {
+ // A fixed-size set of small integers for the dataflow analyses.
+ class BitSet {
+  private:
+   std::vector<uint64_t> words;
+
+  public:
+   BitSet(size_t size = 0, bool full = false) : words((size + 63) / 64, full ? ~uint64_t(0) : 0) {}
+
+   bool test(size_t i) const {return words[i / 64] >> (i % 64) & 1;}
+   void set(size_t i)        {words[i / 64] |= uint64_t(1) << (i % 64);}
+   void reset(size_t i)      {words[i / 64] &= ~(uint64_t(1) << (i % 64));}
+
+   void intersect(const BitSet &other) {
+    for (size_t i = 0; i < words.size(); i++) words[i] &= other.words[i];
+   }
+
+   void unite(const BitSet &other) {
+    for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+   }
+
+   bool operator==(const BitSet &other) const {return words == other.words;}
+   bool operator!=(const BitSet &other) const {return words != other.words;}
+ };
+}
@@ -0,0 +1,88 @@
+#include <cctype>
+#include <cstdlib>
+#include <unordered_set>
+#include "budget.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+#include "../helpers.h"
+
+Optimiser::BudgetLimits Optimiser::limits;
+
+// A block starts at each label and after each jump or return.
+Optimiser::FunctionCost Optimiser::measure(TACKY::Function &func) {
+ FunctionCost cost = {func.body.size(), 0, 0};
+ std::unordered_set<std::string> temporaries;
+ bool ends_block = true;
+
+ for (TACKY::Instruction &inst : func.body) {
+  cost.blocks += ends_block || std::holds_alternative<TACKY::Label>(inst);
+  ends_block = std::holds_alternative<TACKY::Jump>(inst) || std::holds_alternative<TACKY::JumpIfZero>(inst) ||
+               std::holds_alternative<TACKY::JumpIfNotZero>(inst) || std::holds_alternative<TACKY::Return>(inst);
+
+  TACKY::Value *dst = get_dst(inst);
+  TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+  if (var) temporaries.insert(name_of(var->name));
+ }
+
+ cost.temporaries = temporaries.size();
+ return cost;
+}
+
+bool Optimiser::parse_limit(const std::string &flag) {
+ struct Limit {
+  const char *name;
+  size_t BudgetLimits::*limit;
+ };
+
+ static const Limit flags[] = {
+  {"--opt-max-instructions=", &BudgetLimits::instructions},
+  {"--opt-max-blocks=", &BudgetLimits::blocks},
+  {"--opt-max-temporaries=", &BudgetLimits::temporaries},
+  {"--opt-max-local-instructions=", &BudgetLimits::local_instructions},
+ };
+
+ for (const Limit &limit : flags) {
+  std::string name = limit.name;
+  if (flag.substr(0, name.size()) != name) continue;
+
+  // strtoull would read an empty or malformed value as 0, which sends every
+  // function to the lowest tier.
+  const char *value = flag.c_str() + name.size();
+  char *end;
+  size_t parsed = strtoull(value, &end, 10);
+  if (!isdigit((unsigned char)*value) || *end != '\0') error("Invalid value in " + flag);
+
+  limits.*limit.limit = parsed;
+  return true;
+ }
+
+ if (flag.substr(0, 10) == "--opt-max-") error("Unknown flag " + flag);
+ return false;
+}
+
+Optimiser::Tier Optimiser::tier(TACKY::Function &func, const char *pass) {
+ // Most functions are far below every limit, and are not measured.
+ size_t size = func.body.size();
+ if (size <= limits.blocks && size <= limits.temporaries && size <= limits.instructions && size <= limits.local_instructions) {
+  return Tier::Full;
+ }
+
+ FunctionCost cost = measure(func);
+ std::string reason;
+ if (cost.instructions > limits.local_instructions) {
+  reason = std::to_string(cost.instructions) + " instructions is over --opt-max-local-instructions=" + std::to_string(limits.local_instructions);
+  OptRecord::remark(name_of(func.name), pass, false, "not optimised: " + reason);
+  return Tier::None;
+ }
+
+ if (cost.instructions > limits.instructions) {
+  reason = std::to_string(cost.instructions) + " instructions is over --opt-max-instructions=" + std::to_string(limits.instructions);
+ } else if (cost.blocks > limits.blocks) {
+  reason = std::to_string(cost.blocks) + " blocks is over --opt-max-blocks=" + std::to_string(limits.blocks);
+ } else if (cost.temporaries > limits.temporaries) {
+  reason = std::to_string(cost.temporaries) + " temporaries is over --opt-max-temporaries=" + std::to_string(limits.temporaries);
+ } else return Tier::Full;
+
+ OptRecord::remark(name_of(func.name), pass, false, "downgraded to linear passes: " + reason);
+ return Tier::Local;
+}
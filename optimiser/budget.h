@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include "../tacky/types.h"
+
+namespace Optimiser {
+ struct FunctionCost {
+  size_t instructions, blocks, temporaries;
+ };
+
+ FunctionCost measure(TACKY::Function &func);
+
+ // How much optimisation a function can afford. Machine-generated functions
+ // can be huge, and a pass that is superlinear in their size would dominate
+ // the build, so past the limits a function only gets passes that are linear
+ // in it, and past the last one it is not optimised at all.
+ enum class Tier {
+  None,
+  Local,
+  Full
+ };
+
+ struct BudgetLimits {
+  size_t instructions = 50000;
+  size_t blocks = 5000;
+  size_t temporaries = 20000;
+  size_t local_instructions = 1000000;
+ };
+
+ extern BudgetLimits limits;
+
+ // Takes an --opt-max-*=N flag; false if `flag` is not one. An unknown limit
+ // or a value that is not a number is an error.
+ bool parse_limit(const std::string &flag);
+ // Explains any downgrade in the optimisation record.
+ Tier tier(TACKY::Function &func, const char *pass);
+}
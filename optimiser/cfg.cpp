@@ -0,0 +1,80 @@
+#include "cfg.h"
+#include "../tacky/util.h"
+
+static bool ends_block(TACKY::Instruction &inst) {
+ return std::holds_alternative<TACKY::Jump>(inst) || std::holds_alternative<TACKY::JumpIfZero>(inst) ||
+        std::holds_alternative<TACKY::JumpIfNotZero>(inst) || std::holds_alternative<TACKY::Return>(inst);
+}
+
+Optimiser::CFG::CFG(std::vector<TACKY::Instruction> &body) {
+ bool leader = true;
+
+ for (TACKY::Instruction &inst : body) {
+  TACKY::Label *label = std::get_if<TACKY::Label>(&inst);
+  if (leader || label) {
+   blocks.emplace_back();
+   if (label) labels[name_of(label->name.name)] = blocks.size() - 1;
+  }
+
+  blocks.back().insts.push_back(inst);
+  leader = ends_block(inst);
+ }
+
+ if (blocks.empty()) blocks.emplace_back();
+ connect();
+}
+
+void Optimiser::CFG::connect() {
+ for (Block &block : blocks) {
+  block.preds.clear();
+  block.succs.clear();
+ }
+
+ auto target = [&](TACKY::Var &label) {
+  auto it = labels.find(name_of(label.name));
+  return it == labels.end() ? exit : it->second;
+ };
+
+ for (size_t i = 0; i < blocks.size(); i++) {
+  Block &block = blocks[i];
+  size_t next = i + 1 < blocks.size() ? i + 1 : exit;
+  TACKY::Instruction *last = block.insts.empty() ? nullptr : &block.insts.back();
+
+  if (last == nullptr) {
+   block.succs.push_back(next);
+  } else if (TACKY::Jump *jump = std::get_if<TACKY::Jump>(last); jump) {
+   block.succs.push_back(target(jump->target));
+  } else if (TACKY::JumpIfZero *jump = std::get_if<TACKY::JumpIfZero>(last); jump) {
+   block.succs.push_back(next);
+   if (target(jump->target) != next) block.succs.push_back(target(jump->target));
+  } else if (TACKY::JumpIfNotZero *jump = std::get_if<TACKY::JumpIfNotZero>(last); jump) {
+   block.succs.push_back(next);
+   if (target(jump->target) != next) block.succs.push_back(target(jump->target));
+  } else if (std::holds_alternative<TACKY::Return>(*last)) {
+   block.succs.push_back(exit);
+  } else {
+   block.succs.push_back(next);
+  }
+
+  for (size_t succ : block.succs) {
+   if (succ != exit) blocks[succ].preds.push_back(i);
+  }
+ }
+}
+
+std::vector<TACKY::Instruction> Optimiser::CFG::linearise() {
+ std::vector<TACKY::Instruction> body;
+ body.reserve(size());
+
+ for (Block &block : blocks) {
+  body.insert(body.end(), block.insts.begin(), block.insts.end());
+ }
+
+ return body;
+}
+
+size_t Optimiser::CFG::size() {
+ size_t size = 0;
+ for (Block &block : blocks) size += block.insts.size();
+ return size;
+}
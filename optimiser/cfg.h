@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "../tacky/types.h"
+
+namespace Optimiser {
+ struct Block {
+  std::vector<TACKY::Instruction> insts;
+  std::vector<size_t> preds, succs;
+ };
+
+ // A function's body split into basic blocks, kept in layout order so that a
+ // block without a jump at its end falls through to the next one. Block 0 is
+ // the entry, and CFG::exit stands for leaving the function. Passes edit the
+ // instructions in place; one that adds or removes edges must say so, and
+ // the CFG is rebuilt from its linearised body.
+ class CFG {
+  public:
+   static constexpr size_t exit = SIZE_MAX;
+
+   std::vector<Block> blocks;
+   // The block each label starts.
+   std::unordered_map<std::string, size_t> labels;
+
+   CFG() = delete;
+   CFG(std::vector<TACKY::Instruction> &body);
+
+   // Recomputes the edges from the instructions that end each block.
+   void connect();
+   std::vector<TACKY::Instruction> linearise();
+   size_t size();
+ };
+}
@@ -0,0 +1,237 @@
+#include <climits>
+#include <algorithm>
+#include "passes.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+int Optimiser::bits(Parser::Type type) {
+ return get_type_size(type) == 1 ? 32 : 64;
+}
+
+size_t Optimiser::wrap(size_t val, Parser::Type type) {
+ return bits(type) == 32 ? val & 0xffffffff : val;
+}
+
+int64_t Optimiser::as_signed(size_t val, Parser::Type type) {
+ return bits(type) == 32 ? (int64_t)(int32_t)(uint32_t)val : (int64_t)val;
+}
+
+TACKY::Constant Optimiser::make_constant(size_t val, Parser::Type type) {
+ TACKY::Constant konst(wrap(val, type));
+ konst.type = type;
+
+ return konst;
+}
+
+Parser::Type Optimiser::type_of(TACKY::Value &val) {
+ return std::visit([](auto &val) {return val.type;}, val);
+}
+
+static bool same_size(Parser::Type a, Parser::Type b) {
+ return get_type_size(a) == get_type_size(b);
+}
+
+bool Optimiser::fold_unary(TACKY::Unary &unary, size_t src, size_t &result) {
+ Parser::Type type = type_of(unary.src);
+ Parser::Type dst = type_of(unary.dst);
+ src = wrap(src, type);
+
+ if (unary.op == Parser::UnaryOp::Not) {
+  result = wrap(src == 0, dst);
+  return true;
+ }
+
+ if (!same_size(type, dst)) return false;
+
+ switch (unary.op) {
+  case Parser::UnaryOp::Complement: result = ~src;   break;
+  case Parser::UnaryOp::Negate:     result = 0 - src; break;
+  case Parser::UnaryOp::Increment:  result = src + 1; break;
+  case Parser::UnaryOp::Decrement:  result = src - 1; break;
+  default: return false;
+ }
+
+ result = wrap(result, dst);
+ return true;
+}
+
+// Mirrors Generator::generate: comparisons and division are signed if either
+// operand is, and happen at the first operand's width; shifts take their
+// signedness from the value shifted.
+bool Optimiser::fold_binary(TACKY::Binary &binary, size_t src1, size_t src2, size_t &result) {
+ Parser::Type type1 = type_of(binary.src1);
+ Parser::Type type2 = type_of(binary.src2);
+ Parser::Type dst = type_of(binary.dst);
+ bool is_signed = ::is_signed(type1) || ::is_signed(type2);
+
+ src1 = wrap(src1, type1);
+ src2 = wrap(src2, type2);
+ int64_t signed1 = as_signed(src1, type1);
+ int64_t signed2 = as_signed(src2, type2);
+
+ switch (binary.op) {
+  case Parser::BinaryOp::Equal:
+  case Parser::BinaryOp::Not_Equal:
+  case Parser::BinaryOp::Less_Than:
+  case Parser::BinaryOp::Less_Or_Equal:
+  case Parser::BinaryOp::Greater_Than:
+  case Parser::BinaryOp::Greater_Or_Equal: {
+   if (!same_size(type1, type2)) return false;
+
+   bool less = is_signed ? signed1 < signed2 : src1 < src2;
+   bool equal = src1 == src2;
+   switch (binary.op) {
+    case Parser::BinaryOp::Equal:            result = equal;           break;
+    case Parser::BinaryOp::Not_Equal:        result = !equal;          break;
+    case Parser::BinaryOp::Less_Than:        result = less;            break;
+    case Parser::BinaryOp::Less_Or_Equal:    result = less || equal;   break;
+    case Parser::BinaryOp::Greater_Than:     result = !less && !equal; break;
+    case Parser::BinaryOp::Greater_Or_Equal: result = !less;           break;
+    default: break;
+   }
+
+   result = wrap(result, dst);
+   return true;
+  }
+  case Parser::BinaryOp::Shift_Left:
+  case Parser::BinaryOp::Shift_Right: {
+   int64_t count = ::is_signed(type2) ? signed2 : (int64_t)std::min(src2, (size_t)INT64_MAX);
+   if (!same_size(type1, dst) || count < 0 || count >= bits(type1)) return false;
+
+   if (binary.op == Parser::BinaryOp::Shift_Left) result = src1 << count;
+   else result = ::is_signed(type1) ? (size_t)(signed1 >> count) : src1 >> count;
+
+   result = wrap(result, dst);
+   return true;
+  }
+  default: break;
+ }
+
+ if (!same_size(type1, type2) || !same_size(type1, dst)) return false;
+
+ switch (binary.op) {
+  case Parser::BinaryOp::Addition:     result = src1 + src2; break;
+  case Parser::BinaryOp::Subtract:     result = src1 - src2; break;
+  case Parser::BinaryOp::Multiply:     result = src1 * src2; break;
+  case Parser::BinaryOp::Bitwise_And:  result = src1 & src2; break;
+  case Parser::BinaryOp::Bitwise_Or:   result = src1 | src2; break;
+  case Parser::BinaryOp::Exclusive_Or: result = src1 ^ src2; break;
+  case Parser::BinaryOp::Divide:
+  case Parser::BinaryOp::Remainder: {
+   // Both trap at runtime, so they are left for the program to hit.
+   if (src2 == 0) return false;
+   if (is_signed && signed2 == -1 && signed1 == as_signed(size_t(1) << (bits(type1) - 1), type1)) return false;
+
+   bool divide = binary.op == Parser::BinaryOp::Divide;
+   if (is_signed) result = divide ? signed1 / signed2 : signed1 % signed2;
+   else result = divide ? src1 / src2 : src1 % src2;
+  } break;
+  default: return false;
+ }
+
+ result = wrap(result, dst);
+ return true;
+}
+
+bool Optimiser::fold_conversion(TACKY::Instruction &inst, size_t src, size_t &result) {
+ return std::visit(overloaded{
+  [&](auto &) {return false;},
+  [&](TACKY::SignExtend &extend) {
+   result = wrap(as_signed(src, type_of(extend.src)), type_of(extend.dst));
+   return true;
+  },
+  [&](TACKY::ZeroExtend &extend) {
+   result = wrap(wrap(src, type_of(extend.src)), type_of(extend.dst));
+   return true;
+  },
+  [&](TACKY::Truncate &truncate) {
+   result = wrap(src, type_of(truncate.dst));
+   return true;
+  },
+ }, inst);
+}
+
+static TACKY::Constant *constant(TACKY::Value &val) {
+ return std::get_if<TACKY::Constant>(&val);
+}
+
+bool Optimiser::fold(TACKY::Instruction &inst, size_t &result) {
+ return std::visit(overloaded{
+  [&](auto &) {return false;},
+  [&](TACKY::Unary &unary) {
+   return constant(unary.src) && fold_unary(unary, constant(unary.src)->_const, result);
+  },
+  [&](TACKY::Binary &binary) {
+   return constant(binary.src1) && constant(binary.src2) &&
+          fold_binary(binary, constant(binary.src1)->_const, constant(binary.src2)->_const, result);
+  },
+  [&](TACKY::SignExtend &extend) {return constant(extend.src) && fold_conversion(inst, constant(extend.src)->_const, result);},
+  [&](TACKY::ZeroExtend &extend) {return constant(extend.src) && fold_conversion(inst, constant(extend.src)->_const, result);},
+  [&](TACKY::Truncate &truncate) {return constant(truncate.src) && fold_conversion(inst, constant(truncate.src)->_const, result);},
+ }, inst);
+}
+
+// Replaces instructions whose operands are all constants with a copy of the
+// result, and branches on constants with a jump or nothing.
+Optimiser::Change Optimiser::fold_constants(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ size_t folded = 0, retyped = 0, branches = 0;
+
+ for (Block &block : cfg.blocks) {
+  for (size_t i = 0; i < block.insts.size(); i++) {
+   TACKY::Instruction &inst = block.insts[i];
+   size_t result;
+
+   if (fold(inst, result)) {
+    TACKY::Value dst = *get_dst(inst);
+    inst = TACKY::Copy(make_constant(result, type_of(dst)), dst);
+    folded++;
+    continue;
+   }
+
+   // A cast between types of the same size is a copy; giving the constant
+   // the destination's type lets later passes treat it as one.
+   if (TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst); copy && constant(copy->src)) {
+    Parser::Type type = type_of(copy->dst);
+    TACKY::Constant *src = constant(copy->src);
+    if (src->type != type && same_size(src->type, type)) {
+     copy->src = make_constant(src->_const, type);
+     retyped++;
+    }
+    continue;
+   }
+
+   TACKY::Value *cond = nullptr;
+   TACKY::Var target;
+   bool jump_if_zero = false;
+   if (TACKY::JumpIfZero *jump = std::get_if<TACKY::JumpIfZero>(&inst); jump) {
+    cond = &jump->val;
+    target = jump->target;
+    jump_if_zero = true;
+   } else if (TACKY::JumpIfNotZero *jump = std::get_if<TACKY::JumpIfNotZero>(&inst); jump) {
+    cond = &jump->val;
+    target = jump->target;
+   }
+
+   if (cond == nullptr || !constant(*cond)) continue;
+
+   bool zero = wrap(constant(*cond)->_const, constant(*cond)->type) == 0;
+   if (zero == jump_if_zero) {
+    inst = TACKY::Jump(target);
+   } else {
+    block.insts.erase(block.insts.begin() + i);
+    i--;
+   }
+   branches++;
+  }
+ }
+
+ if (folded + branches > 0) {
+  OptRecord::remark(analyses.name(), "fold", true,
+   "folded " + std::to_string(folded) + " instructions and " + std::to_string(branches) + " branches");
+ }
+
+ if (branches > 0) return Change::CFG;
+ return folded + retyped > 0 ? Change::Instructions : Change::None;
+}
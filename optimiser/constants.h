@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include "../tacky/types.h"
+
+// Compile-time evaluation with the same results as the generated code. A
+// constant holds its value zero-extended from the width of its type, the
+// form the emitter prints immediates in.
+namespace Optimiser {
+ int bits(Parser::Type type);
+ size_t wrap(size_t val, Parser::Type type);
+ int64_t as_signed(size_t val, Parser::Type type);
+ TACKY::Constant make_constant(size_t val, Parser::Type type);
+ Parser::Type type_of(TACKY::Value &val);
+
+ // Each returns false when the operation cannot be folded: the types do not
+ // match what code generation expects, or the result would trap or is
+ // undefined (division by zero, INT_MIN / -1, out-of-range shifts).
+ bool fold_unary(TACKY::Unary &unary, size_t src, size_t &result);
+ bool fold_binary(TACKY::Binary &binary, size_t src1, size_t src2, size_t &result);
+ // SignExtend, ZeroExtend and Truncate.
+ bool fold_conversion(TACKY::Instruction &inst, size_t src, size_t &result);
+ // Any of the above, for an instruction whose operands are all constants.
+ bool fold(TACKY::Instruction &inst, size_t &result);
+}
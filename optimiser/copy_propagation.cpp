@@ -0,0 +1,183 @@
+#include <unordered_map>
+#include "passes.h"
+#include "bitset.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+namespace {
+ // Every distinct dst = src copy in the function, with the copies each
+ // variable takes part in so that a write to it can kill them.
+ class Copies {
+  private:
+   Optimiser::FunctionAnalyses &analyses;
+   std::unordered_map<std::string, size_t> index;
+   std::unordered_map<std::string, std::vector<size_t>> involving, into;
+   std::vector<size_t> statics;
+
+   std::string key(TACKY::Copy &copy) {
+    std::string dst = name_of(std::get<TACKY::Var>(copy.dst).name);
+    return std::visit(overloaded{
+     [&](TACKY::Var &var) {return dst + '=' + name_of(var.name);},
+     [&](TACKY::Constant &konst) {return dst + "=#" + std::to_string((int)konst.type) + ':' + std::to_string(konst._const);},
+    }, copy.src);
+   }
+
+  public:
+   std::vector<TACKY::Copy> copies;
+
+   Copies(Optimiser::FunctionAnalyses &analyses) : analyses(analyses) {}
+
+   // Only a copy between values of one type can stand in for its
+   // destination; the others are conversions between signednesses.
+   size_t find(TACKY::Instruction &inst) {
+    TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst);
+    if (copy == nullptr || !std::holds_alternative<TACKY::Var>(copy->dst)) return SIZE_MAX;
+    if (Optimiser::type_of(copy->src) != Optimiser::type_of(copy->dst)) return SIZE_MAX;
+
+    auto it = index.find(key(*copy));
+    return it == index.end() ? SIZE_MAX : it->second;
+   }
+
+   void add(TACKY::Instruction &inst) {
+    TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst);
+    if (copy == nullptr || !std::holds_alternative<TACKY::Var>(copy->dst)) return;
+    if (Optimiser::type_of(copy->src) != Optimiser::type_of(copy->dst) || index.count(key(*copy))) return;
+
+    size_t i = copies.size();
+    index[key(*copy)] = i;
+    copies.push_back(*copy);
+
+    std::string dst = name_of(std::get<TACKY::Var>(copy->dst).name);
+    involving[dst].push_back(i);
+    into[dst].push_back(i);
+    bool touches_static = analyses.is_static(dst);
+
+    if (TACKY::Var *src = std::get_if<TACKY::Var>(&copy->src); src) {
+     involving[name_of(src->name)].push_back(i);
+     touches_static = touches_static || analyses.is_static(name_of(src->name));
+    }
+
+    if (touches_static) statics.push_back(i);
+   }
+
+   void kill(const std::string &name, Optimiser::BitSet &reaching) {
+    auto it = involving.find(name);
+    if (it == involving.end()) return;
+    for (size_t i : it->second) reaching.reset(i);
+   }
+
+   // The value a use of `name` can be replaced with, if any.
+   TACKY::Value *source(const std::string &name, Optimiser::BitSet &reaching) {
+    auto it = into.find(name);
+    if (it == into.end()) return nullptr;
+
+    for (size_t i : it->second) {
+     if (reaching.test(i)) return &copies[i].src;
+    }
+    return nullptr;
+   }
+
+   // Whether a copy is redundant: it, or the same copy the other way
+   // round, already holds.
+   bool redundant(TACKY::Instruction &inst, Optimiser::BitSet &reaching) {
+    size_t i = find(inst);
+    if (i != SIZE_MAX && reaching.test(i)) return true;
+
+    TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst);
+    TACKY::Var *src = copy ? std::get_if<TACKY::Var>(&copy->src) : nullptr;
+    if (src == nullptr || i == SIZE_MAX) return false;
+
+    TACKY::Value *back = source(name_of(src->name), reaching);
+    TACKY::Var *back_var = back ? std::get_if<TACKY::Var>(back) : nullptr;
+    return back_var && name_of(back_var->name) == name_of(std::get<TACKY::Var>(copy->dst).name);
+   }
+
+   void transfer(TACKY::Instruction &inst, Optimiser::BitSet &reaching) {
+    if (redundant(inst, reaching)) return;
+
+    if (std::holds_alternative<TACKY::FunCall>(inst)) {
+     for (size_t i : statics) reaching.reset(i);
+    }
+
+    TACKY::Value *dst = get_dst(inst);
+    TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+    if (var) kill(name_of(var->name), reaching);
+
+    if (size_t i = find(inst); i != SIZE_MAX) reaching.set(i);
+   }
+ };
+}
+
+// Replaces uses of a copy's destination with its source wherever the copy
+// reaches along every path, and deletes copies that are already known to
+// hold.
+Optimiser::Change Optimiser::propagate_copies(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ Copies copies(analyses);
+
+ for (Block &block : cfg.blocks) {
+  for (TACKY::Instruction &inst : block.insts) copies.add(inst);
+ }
+ if (copies.copies.empty()) return Change::None;
+
+ size_t size = copies.copies.size();
+ std::vector<BitSet> out(cfg.blocks.size(), BitSet(size, true));
+ auto reaching_in = [&](size_t b) {
+  BitSet in(size, b != 0);
+  for (size_t pred : cfg.blocks[b].preds) {
+   if (dominators.reachable(pred)) in.intersect(out[pred]);
+  }
+  return in;
+ };
+
+ for (bool changed = true; changed;) {
+  changed = false;
+
+  for (size_t b : dominators.rpo) {
+   BitSet reaching = reaching_in(b);
+   for (TACKY::Instruction &inst : cfg.blocks[b].insts) copies.transfer(inst, reaching);
+
+   if (reaching != out[b]) {
+    out[b] = std::move(reaching);
+    changed = true;
+   }
+  }
+ }
+
+ size_t replaced = 0, removed = 0;
+ for (size_t b : dominators.rpo) {
+  BitSet reaching = reaching_in(b);
+  std::vector<TACKY::Instruction> insts;
+  insts.reserve(cfg.blocks[b].insts.size());
+
+  for (TACKY::Instruction &inst : cfg.blocks[b].insts) {
+   if (copies.redundant(inst, reaching)) {
+    removed++;
+    continue;
+   }
+
+   TACKY::Instruction rewritten = inst;
+   for_each_src(rewritten, [&](TACKY::Value &val) {
+    TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+    TACKY::Value *src = var ? copies.source(name_of(var->name), reaching) : nullptr;
+    if (src == nullptr) return;
+
+    val = *src;
+    replaced++;
+   });
+
+   copies.transfer(inst, reaching);
+   insts.push_back(rewritten);
+  }
+
+  cfg.blocks[b].insts = std::move(insts);
+ }
+
+ if (replaced + removed == 0) return Change::None;
+
+ OptRecord::remark(analyses.name(), "copy-prop", true,
+  "replaced " + std::to_string(replaced) + " uses and removed " + std::to_string(removed) + " copies");
+ return Change::Instructions;
+}
@@ -0,0 +1,65 @@
+#include "passes.h"
+#include "liveness.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+// Whether an instruction does nothing but write its destination.
+static bool is_pure(TACKY::Instruction &inst) {
+ return std::holds_alternative<TACKY::Unary>(inst) || std::holds_alternative<TACKY::Binary>(inst) ||
+        std::holds_alternative<TACKY::Copy>(inst) || std::holds_alternative<TACKY::SignExtend>(inst) ||
+        std::holds_alternative<TACKY::ZeroExtend>(inst) || std::holds_alternative<TACKY::Truncate>(inst);
+}
+
+static bool is_self_copy(TACKY::Instruction &inst) {
+ TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst);
+ TACKY::Var *src = copy ? std::get_if<TACKY::Var>(&copy->src) : nullptr;
+ TACKY::Var *dst = copy ? std::get_if<TACKY::Var>(&copy->dst) : nullptr;
+ return src && dst && name_of(src->name) == name_of(dst->name);
+}
+
+// Deletes instructions whose result is never read, and stops calls storing
+// a result nobody reads.
+Optimiser::Change Optimiser::eliminate_dead_stores(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ Liveness liveness(analyses);
+ size_t removed = 0, results = 0;
+
+ for (size_t b = 0; b < cfg.blocks.size(); b++) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  std::vector<bool> dead(insts.size(), false);
+  BitSet live = liveness.live_out[b];
+
+  for (size_t i = insts.size(); i-- > 0;) {
+   TACKY::Value *dst = get_dst(insts[i]);
+   size_t var = dst ? liveness.find(*dst) : SIZE_MAX;
+   bool unused = var != SIZE_MAX && !live.test(var);
+
+   if ((unused && is_pure(insts[i])) || is_self_copy(insts[i])) {
+    dead[i] = true;
+    removed++;
+    continue;
+   }
+
+   if (unused && std::holds_alternative<TACKY::FunCall>(insts[i])) {
+    std::get<TACKY::FunCall>(insts[i]).dst = TACKY::Constant();
+    results++;
+   }
+
+   liveness.transfer(insts[i], live);
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < insts.size(); i++) {
+   if (dead[i]) continue;
+   if (kept != i) insts[kept] = std::move(insts[i]);
+   kept++;
+  }
+  insts.resize(kept);
+ }
+
+ if (removed + results == 0) return Change::None;
+
+ OptRecord::remark(analyses.name(), "dse", true,
+  "removed " + std::to_string(removed) + " dead instructions and " + std::to_string(results) + " unused call results");
+ return Change::Instructions;
+}
@@ -0,0 +1,114 @@
+#include <utility>
+#include "dominators.h"
+
+Optimiser::DominatorTree::DominatorTree(CFG &cfg) : have_frontiers(false) {
+ size_t num_blocks = cfg.blocks.size();
+ idom.assign(num_blocks, none);
+ children.resize(num_blocks);
+
+ // Postorder without recursion, since generated functions can be deep.
+ std::vector<size_t> order(num_blocks, none), postorder;
+ std::vector<bool> seen(num_blocks, false);
+ std::vector<std::pair<size_t, size_t>> stack = {{0, 0}};
+ seen[0] = true;
+
+ while (!stack.empty()) {
+  auto &[block, next] = stack.back();
+  std::vector<size_t> &succs = cfg.blocks[block].succs;
+
+  if (next < succs.size()) {
+   size_t succ = succs[next++];
+   if (succ != CFG::exit && !seen[succ]) {
+    seen[succ] = true;
+    stack.push_back({succ, 0});
+   }
+   continue;
+  }
+
+  order[block] = postorder.size();
+  postorder.push_back(block);
+  stack.pop_back();
+ }
+
+ rpo.assign(postorder.rbegin(), postorder.rend());
+
+ auto intersect = [&](size_t a, size_t b) {
+  while (a != b) {
+   while (order[a] < order[b]) a = idom[a];
+   while (order[b] < order[a]) b = idom[b];
+  }
+  return a;
+ };
+
+ idom[0] = 0;
+ for (bool changed = true; changed;) {
+  changed = false;
+
+  for (size_t i = 1; i < rpo.size(); i++) {
+   size_t block = rpo[i], new_idom = none;
+   for (size_t pred : cfg.blocks[block].preds) {
+    if (idom[pred] == none) continue;
+    new_idom = new_idom == none ? pred : intersect(pred, new_idom);
+   }
+
+   if (new_idom != idom[block]) {
+    idom[block] = new_idom;
+    changed = true;
+   }
+  }
+ }
+
+ idom[0] = none;
+ for (size_t block : rpo) {
+  if (idom[block] != none) children[idom[block]].push_back(block);
+ }
+
+ // Preorder and postorder numbers on the tree answer dominance in O(1).
+ pre.assign(num_blocks, 0);
+ post.assign(num_blocks, 0);
+ size_t clock = 0;
+ std::vector<std::pair<size_t, size_t>> walk = {{0, 0}};
+ pre[0] = ++clock;
+
+ while (!walk.empty()) {
+  auto &[block, next] = walk.back();
+  if (next < children[block].size()) {
+   size_t child = children[block][next++];
+   pre[child] = ++clock;
+   walk.push_back({child, 0});
+   continue;
+  }
+
+  post[block] = ++clock;
+  walk.pop_back();
+ }
+}
+
+bool Optimiser::DominatorTree::reachable(size_t block) {
+ return block == 0 || idom[block] != none;
+}
+
+bool Optimiser::DominatorTree::dominates(size_t a, size_t b) {
+ if (!reachable(a) || !reachable(b)) return false;
+ return pre[a] <= pre[b] && post[b] <= post[a];
+}
+
+std::vector<std::vector<size_t>> &Optimiser::DominatorTree::frontiers(CFG &cfg) {
+ if (have_frontiers) return df;
+
+ df.assign(cfg.blocks.size(), {});
+ for (size_t block : rpo) {
+  std::vector<size_t> &preds = cfg.blocks[block].preds;
+  if (preds.size() < 2) continue;
+
+  for (size_t pred : preds) {
+   for (size_t runner = pred; reachable(runner) && runner != idom[block]; runner = idom[runner]) {
+    if (df[runner].empty() || df[runner].back() != block) df[runner].push_back(block);
+    if (runner == 0) break;
+   }
+  }
+ }
+
+ have_frontiers = true;
+ return df;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "cfg.h"
+
+namespace Optimiser {
+ // Immediate dominators by Cooper, Harvey and Kennedy's iterative algorithm
+ // over reverse postorder. Blocks unreachable from the entry have no
+ // immediate dominator and dominate nothing.
+ class DominatorTree {
+  private:
+   std::vector<size_t> pre, post;
+   std::vector<std::vector<size_t>> df;
+   bool have_frontiers;
+
+  public:
+   static constexpr size_t none = SIZE_MAX;
+
+   std::vector<size_t> idom;
+   // Reachable blocks in reverse postorder; the entry is first.
+   std::vector<size_t> rpo;
+   std::vector<std::vector<size_t>> children;
+
+   DominatorTree() = delete;
+   DominatorTree(CFG &cfg);
+
+   bool reachable(size_t block);
+   bool dominates(size_t a, size_t b);
+   // Dominance frontiers, computed on first use.
+   std::vector<std::vector<size_t>> &frontiers(CFG &cfg);
+ };
+}
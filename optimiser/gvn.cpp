@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <unordered_map>
+#include "passes.h"
+#include "ssa.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+using Parser::BinaryOp;
+
+static std::string key_of(TACKY::Value &val) {
+ return std::visit(overloaded{
+  [](TACKY::Var &var) {return name_of(var.name) + ':' + std::to_string((int)var.type);},
+  [](TACKY::Constant &konst) {return '#' + std::to_string(konst._const) + ':' + std::to_string((int)konst.type);},
+ }, val);
+}
+
+static bool commutes(BinaryOp op) {
+ return op == BinaryOp::Addition || op == BinaryOp::Multiply || op == BinaryOp::Bitwise_And ||
+        op == BinaryOp::Bitwise_Or || op == BinaryOp::Exclusive_Or || op == BinaryOp::Equal || op == BinaryOp::Not_Equal;
+}
+
+// What an instruction computes, as a key that equal computations share, or
+// "" if it is not one GVN can reuse: its result must be an SSA variable and
+// it must read no static variable.
+static std::string expression(Optimiser::SSA &ssa, TACKY::Instruction &inst) {
+ TACKY::Value *dst = get_dst(inst);
+ if (dst == nullptr || !ssa.is_ssa(*dst) || std::holds_alternative<TACKY::FunCall>(inst)) return "";
+
+ bool reads_static = false;
+ for_each_src(inst, [&](TACKY::Value &val) {
+  reads_static = reads_static || (std::holds_alternative<TACKY::Var>(val) && !ssa.is_ssa(val));
+ });
+ if (reads_static) return "";
+
+ std::string key = std::visit(overloaded{
+  [](auto &) -> std::string {return "";},
+  [](TACKY::Unary &unary) {return 'u' + std::to_string((int)unary.op) + ' ' + key_of(unary.src);},
+  [](TACKY::Binary &binary) {
+   std::string src1 = key_of(binary.src1), src2 = key_of(binary.src2);
+   if (commutes(binary.op) && Optimiser::type_of(binary.src1) == Optimiser::type_of(binary.src2) && src2 < src1) std::swap(src1, src2);
+   return 'b' + std::to_string((int)binary.op) + ' ' + src1 + ' ' + src2;
+  },
+  [](TACKY::SignExtend &extend) {return "s " + key_of(extend.src);},
+  [](TACKY::ZeroExtend &extend) {return "z " + key_of(extend.src);},
+  [](TACKY::Truncate &truncate) {return "t " + key_of(truncate.src);},
+  // A copy between types is a conversion; one within a type is just a name.
+  [](TACKY::Copy &copy) -> std::string {
+   if (Optimiser::type_of(copy.src) == Optimiser::type_of(copy.dst)) return "";
+   return "c " + key_of(copy.src);
+  },
+ }, inst);
+
+ if (key.empty()) return "";
+ return key + " -> " + std::to_string((int)Optimiser::type_of(*dst));
+}
+
+// Dominator-based value numbering over SSA form: walking the dominator tree,
+// a computation already made in a dominating block is replaced by its
+// result, as are copies and phis whose operands are all one value.
+Optimiser::Change Optimiser::number_values(FunctionAnalyses &analyses) {
+ std::vector<TACKY::Instruction> before = analyses.cfg().linearise();
+ SSA ssa(analyses);
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+
+ std::unordered_map<std::string, TACKY::Value> leader;
+ std::unordered_map<std::string, TACKY::Value> available;
+ size_t removed = 0, phis = 0;
+
+ // A leader is defined in a block that strictly dominates its follower, so
+ // the chain ends.
+ auto substitute = [&](TACKY::Value &val) {
+  for (TACKY::Var *var = std::get_if<TACKY::Var>(&val); var; var = std::get_if<TACKY::Var>(&val)) {
+   auto it = leader.find(name_of(var->name));
+   if (it == leader.end()) break;
+   val = it->second;
+  }
+ };
+
+ auto enter = [&](size_t b, std::vector<std::string> &added) {
+  std::vector<Phi> &block_phis = ssa.phis[b];
+  for (size_t i = 0; i < block_phis.size();) {
+   Phi &phi = block_phis[i];
+   std::string dst = name_of(phi.dst.name);
+
+   // An argument from a back edge is not numbered yet, but if it is the
+   // phi itself or the same name as the others, the phi is still that value.
+   TACKY::Value *same = nullptr;
+   bool one_value = true;
+   std::string key = "phi " + std::to_string(b);
+   for (TACKY::Value &arg : phi.args) {
+    key += ' ' + key_of(arg);
+    TACKY::Var *var = std::get_if<TACKY::Var>(&arg);
+    if (var && name_of(var->name) == dst) continue;
+
+    if (same == nullptr) same = &arg;
+    else one_value = one_value && key_of(*same) == key_of(arg);
+   }
+
+   auto it = available.find(key);
+   if ((one_value && same) || it != available.end()) {
+    leader[dst] = one_value && same ? *same : it->second;
+    block_phis.erase(block_phis.begin() + i);
+    phis++;
+    continue;
+   }
+
+   available.emplace(key, phi.dst);
+   added.push_back(key);
+   i++;
+  }
+
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  size_t kept = 0;
+  for (size_t i = 0; i < insts.size(); i++) {
+   for_each_src(insts[i], substitute);
+   TACKY::Value *dst = get_dst(insts[i]);
+
+   TACKY::Copy *copy = std::get_if<TACKY::Copy>(&insts[i]);
+   if (copy && ssa.is_ssa(copy->dst) && type_of(copy->src) == type_of(copy->dst) &&
+       (std::holds_alternative<TACKY::Constant>(copy->src) || ssa.is_ssa(copy->src))) {
+    leader[name_of(std::get<TACKY::Var>(copy->dst).name)] = copy->src;
+    continue;
+   }
+
+   std::string key = expression(ssa, insts[i]);
+   auto it = key.empty() ? available.end() : available.find(key);
+   if (it != available.end()) {
+    leader[name_of(std::get<TACKY::Var>(*dst).name)] = it->second;
+    removed++;
+    continue;
+   }
+   if (!key.empty()) {
+    available.emplace(key, *dst);
+    added.push_back(key);
+   }
+
+   if (kept != i) insts[kept] = std::move(insts[i]);
+   kept++;
+  }
+  insts.resize(kept);
+
+  for (size_t succ : cfg.blocks[b].succs) {
+   if (succ == CFG::exit) continue;
+
+   std::vector<size_t> &preds = cfg.blocks[succ].preds;
+   size_t j = std::find(preds.begin(), preds.end(), b) - preds.begin();
+   for (Phi &phi : ssa.phis[succ]) substitute(phi.args[j]);
+  }
+ };
+
+ struct Frame {
+  size_t block, next;
+  std::vector<std::string> added;
+ };
+
+ std::vector<Frame> walk = {{0, 0, {}}};
+ enter(0, walk.back().added);
+
+ while (!walk.empty()) {
+  Frame &frame = walk.back();
+  if (frame.next < dominators.children[frame.block].size()) {
+   size_t child = dominators.children[frame.block][frame.next++];
+   walk.push_back({child, 0, {}});
+   enter(child, walk.back().added);
+   continue;
+  }
+
+  for (std::string &key : frame.added) available.erase(key);
+  walk.pop_back();
+ }
+
+ ssa.leave();
+
+ // Going into SSA form and back renames everything, so with nothing found
+ // the function is put back as it was.
+ if (removed == 0) {
+  cfg = CFG(before);
+  analyses.invalidate(Change::CFG);
+  return Change::None;
+ }
+
+ OptRecord::remark(analyses.name(), "gvn", true,
+  "removed " + std::to_string(removed) + " redundant computations and " + std::to_string(phis) + " phis");
+ return Change::CFG;
+}
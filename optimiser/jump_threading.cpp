@@ -0,0 +1,412 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "passes.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+using Parser::BinaryOp;
+
+// Only a block this small is copied onto the edge that knows its outcome.
+static constexpr size_t max_block_size = 8;
+// How many single-predecessor blocks back a path is followed for facts.
+static constexpr int max_depth = 4;
+
+namespace {
+ // The values a variable can hold on a path: an interval with at most one
+ // value missing. Values are kept as keys that order them the way the
+ // variable's comparisons do, so signed and unsigned share one form.
+ struct Range {
+  Parser::Type type;
+  int64_t lo, hi;
+  bool has_hole = false;
+  int64_t hole = 0;
+
+  bool empty() const {return lo > hi;}
+  bool contains(int64_t key) const {return lo <= key && key <= hi && !(has_hole && hole == key);}
+ };
+}
+
+static int64_t key(size_t val, Parser::Type type) {
+ if (is_signed(type)) return Optimiser::as_signed(val, type);
+ return (int64_t)(Optimiser::wrap(val, type) ^ (size_t(1) << 63));
+}
+
+// Moves the bounds off the hole, and forgets a hole outside them.
+static Range normalise(Range range) {
+ if (range.has_hole && range.hole == range.lo && range.lo != INT64_MAX) range.lo++;
+ if (range.has_hole && range.hole == range.hi && range.hi != INT64_MIN) range.hi--;
+ if (range.has_hole && !(range.lo < range.hole && range.hole < range.hi)) range.has_hole = false;
+ return range;
+}
+
+static Range intersect(Range a, Range b) {
+ Range result = {a.type, std::max(a.lo, b.lo), std::min(a.hi, b.hi), a.has_hole || b.has_hole, a.has_hole ? a.hole : b.hole};
+ result = normalise(result);
+
+ // Only one hole fits; the other is kept only if it narrows a bound.
+ if (a.has_hole && b.has_hole && a.hole != b.hole) {
+  result.has_hole = true;
+  result.hole = b.hole;
+  result = normalise(result);
+ }
+ return result;
+}
+
+static Range empty(Parser::Type type) {
+ return {type, INT64_MAX, INT64_MIN};
+}
+
+// The values of a variable of `type` for which "var op val" holds.
+static Range satisfying(BinaryOp op, size_t val, Parser::Type type) {
+ int bits = Optimiser::bits(type);
+ Range range = is_signed(type)
+  ? Range{type, key(size_t(1) << (bits - 1), type), key((size_t(1) << (bits - 1)) - 1, type)}
+  : Range{type, key(0, type), key(SIZE_MAX, type)};
+ int64_t k = key(val, type);
+
+ switch (op) {
+  case BinaryOp::Equal:            range.lo = range.hi = k; break;
+  case BinaryOp::Not_Equal:        range.has_hole = true; range.hole = k; break;
+  case BinaryOp::Less_Than:        if (k == range.lo) range = empty(type); else range.hi = k - 1; break;
+  case BinaryOp::Less_Or_Equal:    range.hi = k; break;
+  case BinaryOp::Greater_Than:     if (k == range.hi) range = empty(type); else range.lo = k + 1; break;
+  case BinaryOp::Greater_Or_Equal: range.lo = k; break;
+  default: break;
+ }
+ return normalise(range);
+}
+
+// Whether "var op val" holds for every value in the range (1), for none
+// (0), or it depends (-1).
+static int evaluate(Range range, BinaryOp op, size_t val) {
+ if (range.empty()) return -1;
+
+ Range holds = satisfying(op, val, range.type);
+ if (intersect(range, holds).empty()) return 0;
+
+ bool within = range.lo >= holds.lo && range.hi <= holds.hi;
+ if (within && !(holds.has_hole && range.contains(holds.hole))) return 1;
+ return -1;
+}
+
+static BinaryOp negate(BinaryOp op) {
+ switch (op) {
+  case BinaryOp::Equal:            return BinaryOp::Not_Equal;
+  case BinaryOp::Not_Equal:        return BinaryOp::Equal;
+  case BinaryOp::Less_Than:        return BinaryOp::Greater_Or_Equal;
+  case BinaryOp::Less_Or_Equal:    return BinaryOp::Greater_Than;
+  case BinaryOp::Greater_Than:     return BinaryOp::Less_Or_Equal;
+  case BinaryOp::Greater_Or_Equal: return BinaryOp::Less_Than;
+  default: return BinaryOp::Error;
+ }
+}
+
+static BinaryOp mirror(BinaryOp op) {
+ switch (op) {
+  case BinaryOp::Less_Than:        return BinaryOp::Greater_Than;
+  case BinaryOp::Less_Or_Equal:    return BinaryOp::Greater_Or_Equal;
+  case BinaryOp::Greater_Than:     return BinaryOp::Less_Than;
+  case BinaryOp::Greater_Or_Equal: return BinaryOp::Less_Or_Equal;
+  default: return op;
+ }
+}
+
+namespace {
+ // A comparison of a variable with a constant of the same type, written
+ // with the variable first.
+ struct Comparison {
+  std::string var;
+  BinaryOp op;
+  size_t val;
+  Parser::Type type;
+ };
+
+ enum class Via {
+  Target,
+  FallThrough
+ };
+
+ // A copy of `block` for `pred` to go to instead, ending in a jump to the
+ // side of its branch already known.
+ struct Thread {
+  size_t pred, block;
+  Via via;
+  size_t at;
+  std::vector<TACKY::Instruction> insts;
+  TACKY::Var dest;
+ };
+}
+
+static bool comparison(TACKY::Instruction &inst, Comparison &result) {
+ TACKY::Binary *binary = std::get_if<TACKY::Binary>(&inst);
+ if (binary == nullptr || negate(binary->op) == BinaryOp::Error) return false;
+
+ TACKY::Var *var = std::get_if<TACKY::Var>(&binary->src1);
+ TACKY::Constant *konst = std::get_if<TACKY::Constant>(&binary->src2);
+ BinaryOp op = binary->op;
+ if (var == nullptr) {
+  var = std::get_if<TACKY::Var>(&binary->src2);
+  konst = std::get_if<TACKY::Constant>(&binary->src1);
+  op = mirror(op);
+ }
+ if (var == nullptr || konst == nullptr || var->type != konst->type) return false;
+
+ result = {name_of(var->name), op, konst->_const, var->type};
+ return true;
+}
+
+// The variable a block's closing branch tests, if it ends in one.
+static TACKY::Var *tested(std::vector<TACKY::Instruction> &insts) {
+ if (insts.empty()) return nullptr;
+ return std::visit(overloaded{
+  [](auto &) -> TACKY::Var * {return nullptr;},
+  [](TACKY::JumpIfZero &jump)    {return std::get_if<TACKY::Var>(&jump.val);},
+  [](TACKY::JumpIfNotZero &jump) {return std::get_if<TACKY::Var>(&jump.val);},
+ }, insts.back());
+}
+
+namespace {
+ using Facts = std::unordered_map<std::string, Range>;
+
+ class Threader {
+  private:
+   Optimiser::FunctionAnalyses &analyses;
+   Optimiser::CFG &cfg;
+
+   void assume(Facts &facts, const std::string &name, Range range) {
+    auto it = facts.find(name);
+    if (it == facts.end()) facts.emplace(name, range);
+    else it->second = intersect(it->second, range);
+   }
+
+   void kill(Facts &facts, TACKY::Instruction &inst) {
+    if (std::holds_alternative<TACKY::FunCall>(inst)) {
+     for (auto it = facts.begin(); it != facts.end();) {
+      if (analyses.is_static(it->first)) it = facts.erase(it);
+      else it++;
+     }
+    }
+
+    TACKY::Value *dst = get_dst(inst);
+    TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+    if (var) facts.erase(name_of(var->name));
+   }
+
+   // What taking one side of the branch ending `pred` says about the
+   // variable it tests and, through the copies and the comparison that
+   // made it, about the variables before.
+   void assume_branch(Facts &facts, size_t pred, TACKY::Var &var, bool nonzero) {
+    std::vector<TACKY::Instruction> &insts = cfg.blocks[pred].insts;
+    std::string name = name_of(var.name);
+    BinaryOp op = nonzero ? BinaryOp::Not_Equal : BinaryOp::Equal;
+    assume(facts, name, satisfying(op, 0, var.type));
+
+    std::unordered_set<std::string> written;
+    bool called = false;
+    // A copy to another type keeps whether a value is zero only for the 0
+    // or 1 of a comparison.
+    bool retyped = false;
+    auto clobbered = [&](const std::string &name) {
+     return written.count(name) || (called && analyses.is_static(name));
+    };
+
+    for (size_t i = insts.size() - 1; i-- > 0;) {
+     TACKY::Value *dst = get_dst(insts[i]);
+     TACKY::Var *dst_var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+
+     if (dst_var && name_of(dst_var->name) == name) {
+      TACKY::Copy *copy = std::get_if<TACKY::Copy>(&insts[i]);
+      TACKY::Var *src = copy ? std::get_if<TACKY::Var>(&copy->src) : nullptr;
+      Comparison compare;
+
+      if (src && !clobbered(name_of(src->name))) {
+       name = name_of(src->name);
+       retyped = retyped || src->type != dst_var->type;
+       if (!retyped) assume(facts, name, satisfying(op, 0, src->type));
+      } else if (comparison(insts[i], compare) && !clobbered(compare.var)) {
+       assume(facts, compare.var, satisfying(nonzero ? compare.op : negate(compare.op), compare.val, compare.type));
+       break;
+      } else {
+       break;
+      }
+     }
+
+     if (dst_var) written.insert(name_of(dst_var->name));
+     called = called || std::holds_alternative<TACKY::FunCall>(insts[i]);
+    }
+   }
+
+   // Whether `block` is reached from `pred` by its jump or by falling
+   // through, or either or neither.
+   bool reaches_by(size_t pred, size_t block, Via &via) {
+    std::vector<TACKY::Instruction> &insts = cfg.blocks[pred].insts;
+    TACKY::Var *target = insts.empty() ? nullptr : get_target(insts.back());
+    auto it = target ? cfg.labels.find(name_of(target->name)) : cfg.labels.end();
+    bool by_target = it != cfg.labels.end() && it->second == block;
+
+    bool ends = !insts.empty() && (std::holds_alternative<TACKY::Jump>(insts.back()) || std::holds_alternative<TACKY::Return>(insts.back()));
+    bool by_fall_through = !ends && pred + 1 == block;
+
+    if (by_target == by_fall_through) return false;
+    via = by_target ? Via::Target : Via::FallThrough;
+    return true;
+   }
+
+   Facts on_edge(size_t pred, size_t block, int depth) {
+    Facts facts = at_end(pred, depth);
+    TACKY::Var *var = tested(cfg.blocks[pred].insts);
+    Via via;
+    if (var == nullptr || !reaches_by(pred, block, via)) return facts;
+
+    bool if_zero = std::holds_alternative<TACKY::JumpIfZero>(cfg.blocks[pred].insts.back());
+    assume_branch(facts, pred, *var, if_zero != (via == Via::Target));
+    return facts;
+   }
+
+   // The entry block is also reached from outside, so it has no facts.
+   Facts at_end(size_t block, int depth) {
+    Facts facts;
+    std::vector<size_t> &preds = cfg.blocks[block].preds;
+    if (depth > 0 && block != 0 && preds.size() == 1 && preds[0] != block) {
+     facts = on_edge(preds[0], block, depth - 1);
+    }
+
+    for (TACKY::Instruction &inst : cfg.blocks[block].insts) transfer(facts, inst);
+    return facts;
+   }
+
+  public:
+   Threader(Optimiser::FunctionAnalyses &analyses) : analyses(analyses), cfg(analyses.cfg()) {}
+
+   // A comparison whose outcome the facts decide gives its result a fact;
+   // copies carry their source's.
+   void transfer(Facts &facts, TACKY::Instruction &inst) {
+    Comparison compare;
+    int outcome = -1;
+    if (comparison(inst, compare)) {
+     auto it = facts.find(compare.var);
+     if (it != facts.end()) outcome = evaluate(it->second, compare.op, compare.val);
+    }
+
+    Range copied;
+    bool copies = false;
+    if (TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst); copy) {
+     TACKY::Var *src = std::get_if<TACKY::Var>(&copy->src);
+     Parser::Type type = Optimiser::type_of(copy->dst);
+     auto it = src ? facts.find(name_of(src->name)) : facts.end();
+
+     if (it != facts.end() && src->type == type) {
+      copied = it->second;
+      copies = true;
+     } else if (it != facts.end()) {
+      // 0 and 1 are the same in every type.
+      bool zero = evaluate(it->second, BinaryOp::Equal, 0) == 1, one = evaluate(it->second, BinaryOp::Equal, 1) == 1;
+      copied = satisfying(BinaryOp::Equal, one, type);
+      copies = zero || one;
+     }
+    }
+
+    kill(facts, inst);
+    TACKY::Value *dst = get_dst(inst);
+    TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+    if (var && outcome != -1) facts[name_of(var->name)] = satisfying(BinaryOp::Equal, outcome, var->type);
+    if (var && copies) facts[name_of(var->name)] = copied;
+   }
+
+   // Whether the branch ending `block` is decided on the edge from `pred`:
+   // 1 if it jumps, 0 if it falls through, -1 if either can happen.
+   int decided(size_t pred, size_t block) {
+    Facts facts = on_edge(pred, block, max_depth);
+    std::vector<TACKY::Instruction> &insts = cfg.blocks[block].insts;
+    for (size_t i = 0; i + 1 < insts.size(); i++) transfer(facts, insts[i]);
+
+    TACKY::Var *var = tested(insts);
+    auto it = facts.find(name_of(var->name));
+    if (it == facts.end()) return -1;
+
+    int nonzero = evaluate(it->second, BinaryOp::Not_Equal, 0);
+    if (nonzero == -1) return -1;
+    return std::holds_alternative<TACKY::JumpIfNotZero>(insts.back()) == (nonzero == 1);
+   }
+
+   bool reached_by(size_t pred, size_t block, Via &via) {return reaches_by(pred, block, via);}
+ };
+}
+
+static size_t body_size(std::vector<TACKY::Instruction> &insts) {
+ size_t size = 0;
+ for (TACKY::Instruction &inst : insts) size += !std::holds_alternative<TACKY::Label>(inst);
+ return size;
+}
+
+// Where a path that reaches `block` follows an earlier branch that already
+// settles the one ending `block`, gives that path its own copy of `block`
+// that jumps straight to the known side.
+Optimiser::Change Optimiser::thread_jumps(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ std::vector<TACKY::Instruction> &last = cfg.blocks.back().insts;
+
+ // Copies go at the end, after a block that must not fall through.
+ if (last.empty() || !(std::holds_alternative<TACKY::Jump>(last.back()) || std::holds_alternative<TACKY::Return>(last.back()))) {
+  return Change::None;
+ }
+
+ Threader threader(analyses);
+ std::vector<Thread> threads;
+ // Labels to give blocks that branches now jump to instead of falling into.
+ std::unordered_map<size_t, TACKY::Var> new_labels;
+
+ auto label_of = [&](size_t block) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[block].insts;
+  if (!insts.empty() && std::holds_alternative<TACKY::Label>(insts[0])) return std::get<TACKY::Label>(insts[0]).name;
+
+  auto it = new_labels.find(block);
+  if (it == new_labels.end()) it = new_labels.emplace(block, analyses.label()).first;
+  return it->second;
+ };
+
+ for (size_t b = 1; b < cfg.blocks.size(); b++) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  if (tested(insts) == nullptr || body_size(insts) > max_block_size || b + 1 >= cfg.blocks.size()) continue;
+
+  for (size_t pred : cfg.blocks[b].preds) {
+   Via via;
+   if (pred == b || !threader.reached_by(pred, b, via)) continue;
+
+   int jumps = threader.decided(pred, b);
+   if (jumps == -1) continue;
+
+   Thread thread = {pred, b, via, cfg.blocks[pred].insts.size() - 1, {}, jumps ? *get_target(insts.back()) : label_of(b + 1)};
+   for (size_t i = 0; i + 1 < insts.size(); i++) {
+    if (!std::holds_alternative<TACKY::Label>(insts[i])) thread.insts.push_back(insts[i]);
+   }
+   threads.push_back(std::move(thread));
+  }
+ }
+
+ if (threads.empty()) return Change::None;
+
+ for (Thread &thread : threads) {
+  TACKY::Var label = analyses.label();
+  std::vector<TACKY::Instruction> &pred = cfg.blocks[thread.pred].insts;
+
+  if (thread.via == Via::Target) *get_target(pred[thread.at]) = label;
+  else pred.push_back(TACKY::Jump(label));
+
+  Block copy;
+  copy.insts.push_back(TACKY::Label(label));
+  copy.insts.insert(copy.insts.end(), thread.insts.begin(), thread.insts.end());
+  copy.insts.push_back(TACKY::Jump(thread.dest));
+  cfg.blocks.push_back(std::move(copy));
+ }
+
+ // Last, as it moves the instructions the threads point into.
+ for (auto &[block, label] : new_labels) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[block].insts;
+  insts.insert(insts.begin(), TACKY::Label(label));
+ }
+
+ OptRecord::remark(analyses.name(), "jump-threading", true, "threaded " + std::to_string(threads.size()) + " branches");
+ return Change::CFG;
+}
@@ -0,0 +1,140 @@
+#include <unordered_map>
+#include "passes.h"
+#include "loops.h"
+#include "liveness.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+using Parser::BinaryOp;
+
+// Whether an instruction can run where it did not before: it does nothing
+// but write its result, and cannot trap. Division traps on a zero divisor,
+// and signed division on INT_MIN / -1 too, so only a constant divisor that
+// is neither can be moved.
+static bool speculatable(TACKY::Instruction &inst) {
+ return std::visit(overloaded{
+  [](auto &) {return false;},
+  [](TACKY::Unary &) {return true;},
+  [](TACKY::Copy &) {return true;},
+  [](TACKY::SignExtend &) {return true;},
+  [](TACKY::ZeroExtend &) {return true;},
+  [](TACKY::Truncate &) {return true;},
+  [](TACKY::Binary &binary) {
+   if (binary.op != BinaryOp::Divide && binary.op != BinaryOp::Remainder) return true;
+
+   TACKY::Constant *divisor = std::get_if<TACKY::Constant>(&binary.src2);
+   if (divisor == nullptr) return false;
+
+   size_t val = Optimiser::wrap(divisor->_const, divisor->type);
+   bool is_signed = ::is_signed(Optimiser::type_of(binary.src1)) || ::is_signed(divisor->type);
+   return val != 0 && !(is_signed && Optimiser::as_signed(val, divisor->type) == -1);
+  },
+ }, inst);
+}
+
+// Loop-invariant code motion: an instruction whose operands the loop never
+// writes moves to the loop's preheader, inner loops first so that it can
+// carry on out of the enclosing ones. It must be the loop's only write to
+// its result, which must not be live into the header, nor out of the loop
+// along an exit it does not dominate.
+Optimiser::Change Optimiser::hoist_invariants(FunctionAnalyses &analyses) {
+ std::vector<TACKY::Instruction> before = analyses.cfg().linearise();
+ Loops loops(analyses);
+ if (loops.loops.empty()) return Change::None;
+
+ bool inserted = loops.insert_preheaders();
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ // Moving an instruction out of a loop only shortens the lives it touches
+ // within the enclosing one, so this stays a safe approximation.
+ Liveness liveness(analyses);
+ size_t hoisted = 0, from = 0;
+
+ for (Loop &loop : loops.loops) {
+  if (loop.preheader == CFG::exit) continue;
+
+  // How often the loop writes each variable, and whether it calls anything,
+  // which may write a static variable.
+  std::unordered_map<std::string, size_t> writes;
+  bool calls = false;
+  std::vector<std::pair<size_t, size_t>> exits;
+  for (size_t b : loop.blocks) {
+   for (TACKY::Instruction &inst : cfg.blocks[b].insts) {
+    TACKY::Value *dst = get_dst(inst);
+    TACKY::Var *var = dst ? std::get_if<TACKY::Var>(dst) : nullptr;
+    if (var) writes[name_of(var->name)]++;
+    calls = calls || std::holds_alternative<TACKY::FunCall>(inst);
+   }
+   for (size_t succ : cfg.blocks[b].succs) {
+    if (succ != CFG::exit && !loop.contains(succ)) exits.push_back({b, succ});
+   }
+  }
+
+  auto invariant = [&](TACKY::Value &val) {
+   TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+   if (var == nullptr) return true;
+
+   std::string name = name_of(var->name);
+   return writes.find(name) == writes.end() && !(calls && analyses.is_static(name));
+  };
+
+  auto hoistable = [&](TACKY::Instruction &inst, size_t b) {
+   TACKY::Value *dst = get_dst(inst);
+   if (dst == nullptr || !speculatable(inst)) return false;
+
+   std::string name = name_of(std::get<TACKY::Var>(*dst).name);
+   if (analyses.is_static(name) || writes[name] != 1) return false;
+
+   bool operands = true;
+   for_each_src(inst, [&](TACKY::Value &val) {operands = operands && invariant(val);});
+   if (!operands) return false;
+
+   size_t bit = liveness.find(*dst);
+   if (liveness.live_in[loop.header].test(bit)) return false;
+   for (auto &[exiting, exit] : exits) {
+    if (liveness.live_in[exit].test(bit) && !dominators.dominates(b, exiting)) return false;
+   }
+   return true;
+  };
+
+  std::vector<TACKY::Instruction> &preheader = cfg.blocks[loop.preheader].insts;
+  size_t at = !preheader.empty() && std::holds_alternative<TACKY::Jump>(preheader.back()) ? preheader.size() - 1 : preheader.size();
+  size_t count = hoisted;
+
+  // An instruction moves only once the ones it reads from have.
+  for (bool changed = true; changed;) {
+   changed = false;
+
+   for (size_t b : loop.blocks) {
+    std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+    for (size_t i = 0; i < insts.size();) {
+     if (!hoistable(insts[i], b)) {
+      i++;
+      continue;
+     }
+
+     writes.erase(name_of(std::get<TACKY::Var>(*get_dst(insts[i])).name));
+     preheader.insert(preheader.begin() + at++, std::move(insts[i]));
+     insts.erase(insts.begin() + i);
+     hoisted++;
+     changed = true;
+    }
+   }
+  }
+
+  if (hoisted != count) from++;
+ }
+
+ if (hoisted == 0) {
+  if (inserted) {
+   cfg = CFG(before);
+   analyses.invalidate(Change::CFG);
+  }
+  return Change::None;
+ }
+
+ OptRecord::remark(analyses.name(), "licm", true,
+  "hoisted " + std::to_string(hoisted) + " invariant instructions out of " + std::to_string(from) + " loops");
+ return inserted ? Change::CFG : Change::Instructions;
+}
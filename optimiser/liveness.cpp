@@ -0,0 +1,65 @@
+#include "liveness.h"
+#include "../tacky/util.h"
+
+Optimiser::Liveness::Liveness(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+
+ auto add = [&](TACKY::Value &val) {
+  TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+  if (var == nullptr) return;
+
+  std::string name = name_of(var->name);
+  if (!analyses.is_static(name)) index.emplace(name, index.size());
+ };
+
+ for (Block &block : cfg.blocks) {
+  for (TACKY::Instruction &inst : block.insts) {
+   for_each_src(inst, add);
+   if (TACKY::Value *dst = get_dst(inst); dst) add(*dst);
+  }
+ }
+
+ size_t size = index.size();
+ live_in.assign(cfg.blocks.size(), BitSet(size));
+ live_out.assign(cfg.blocks.size(), BitSet(size));
+
+ // Blocks are visited last to first, which for most loops settles in two
+ // rounds.
+ for (bool changed = true; changed;) {
+  changed = false;
+
+  for (size_t b = cfg.blocks.size(); b-- > 0;) {
+   BitSet live(size);
+   for (size_t succ : cfg.blocks[b].succs) {
+    if (succ != CFG::exit) live.unite(live_in[succ]);
+   }
+   live_out[b] = live;
+
+   std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+   for (size_t i = insts.size(); i-- > 0;) transfer(insts[i], live);
+
+   if (live != live_in[b]) {
+    live_in[b] = std::move(live);
+    changed = true;
+   }
+  }
+ }
+}
+
+size_t Optimiser::Liveness::find(TACKY::Value &val) {
+ TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+ if (var == nullptr) return SIZE_MAX;
+
+ auto it = index.find(name_of(var->name));
+ return it == index.end() ? SIZE_MAX : it->second;
+}
+
+void Optimiser::Liveness::transfer(TACKY::Instruction &inst, BitSet &live) {
+ if (TACKY::Value *dst = get_dst(inst); dst) {
+  if (size_t i = find(*dst); i != SIZE_MAX) live.reset(i);
+ }
+
+ for_each_src(inst, [&](TACKY::Value &val) {
+  if (size_t i = find(val); i != SIZE_MAX) live.set(i);
+ });
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "bitset.h"
+#include "pass_manager.h"
+
+namespace Optimiser {
+ // Which of a function's local variables are live on entry to and exit from
+ // each block. Static variables are not tracked: any call may read them and
+ // they outlive the function, so a write to one is never dead.
+ class Liveness {
+  public:
+   std::unordered_map<std::string, size_t> index;
+   std::vector<BitSet> live_in, live_out;
+
+   Liveness() = delete;
+   Liveness(FunctionAnalyses &analyses);
+
+   // The variable's bit, or SIZE_MAX if it is not tracked.
+   size_t find(TACKY::Value &val);
+   // Steps `live` backwards over one instruction.
+   void transfer(TACKY::Instruction &inst, BitSet &live);
+ };
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include "loops.h"
+#include "../tacky/util.h"
+
+bool Optimiser::Loop::contains(size_t block) {
+ return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+Optimiser::Loops::Loops(FunctionAnalyses &analyses) : analyses(analyses) {
+ find();
+}
+
+void Optimiser::Loops::find() {
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ loops.clear();
+
+ std::vector<size_t> headers;
+ std::vector<std::vector<size_t>> latches(cfg.blocks.size());
+ for (size_t b : dominators.rpo) {
+  for (size_t succ : cfg.blocks[b].succs) {
+   if (succ == CFG::exit || !dominators.dominates(succ, b)) continue;
+
+   if (latches[succ].empty()) headers.push_back(succ);
+   latches[succ].push_back(b);
+  }
+ }
+
+ // Stamped with the header, to avoid clearing.
+ std::vector<size_t> seen(cfg.blocks.size(), CFG::exit);
+ for (size_t header : headers) {
+  Loop loop = {header, {header}, CFG::exit};
+  seen[header] = header;
+
+  std::vector<size_t> work;
+  for (size_t latch : latches[header]) {
+   if (seen[latch] == header) continue;
+   seen[latch] = header;
+   work.push_back(latch);
+  }
+
+  while (!work.empty()) {
+   size_t b = work.back();
+   work.pop_back();
+   loop.blocks.push_back(b);
+
+   for (size_t pred : cfg.blocks[b].preds) {
+    if (seen[pred] == header || !dominators.reachable(pred)) continue;
+    seen[pred] = header;
+    work.push_back(pred);
+   }
+  }
+  std::sort(loop.blocks.begin(), loop.blocks.end());
+
+  // Entering the function is an edge too, so the entry block has no
+  // preheader. Code put before a branch would change what it reads.
+  std::vector<size_t> outside;
+  for (size_t pred : cfg.blocks[header].preds) {
+   if (!loop.contains(pred)) outside.push_back(pred);
+  }
+  if (header != 0 && outside.size() == 1 && cfg.blocks[outside[0]].succs.size() == 1) {
+   std::vector<TACKY::Instruction> &insts = cfg.blocks[outside[0]].insts;
+   bool branches = !insts.empty() && (std::holds_alternative<TACKY::JumpIfZero>(insts.back()) ||
+                                      std::holds_alternative<TACKY::JumpIfNotZero>(insts.back()));
+   if (!branches) loop.preheader = outside[0];
+  }
+
+  loops.push_back(std::move(loop));
+ }
+
+ std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {return a.blocks.size() < b.blocks.size();});
+}
+
+static TACKY::Var label_of(Optimiser::FunctionAnalyses &analyses, Optimiser::Block &block) {
+ if (!block.insts.empty() && std::holds_alternative<TACKY::Label>(block.insts[0])) return std::get<TACKY::Label>(block.insts[0]).name;
+
+ TACKY::Var label = analyses.label();
+ block.insts.insert(block.insts.begin(), TACKY::Label(label));
+ return label;
+}
+
+// Jumps into the loop from outside go to the preheader instead, and a block
+// of the loop that fell through to the header now jumps there.
+bool Optimiser::Loops::insert_preheaders() {
+ CFG &cfg = analyses.cfg();
+ std::vector<Block> added;
+ std::vector<size_t> before(cfg.blocks.size(), CFG::exit);
+
+ for (Loop &loop : loops) {
+  if (loop.preheader != CFG::exit) continue;
+
+  size_t header = loop.header;
+  TACKY::Var header_label = label_of(analyses, cfg.blocks[header]);
+  TACKY::Var label = analyses.label();
+
+  for (size_t pred : cfg.blocks[header].preds) {
+   std::vector<TACKY::Instruction> &insts = cfg.blocks[pred].insts;
+   TACKY::Var *target = insts.empty() ? nullptr : get_target(insts.back());
+   if (!loop.contains(pred) && target && name_of(target->name) == name_of(header_label.name)) *target = label;
+  }
+
+  if (header > 0 && loop.contains(header - 1)) {
+   std::vector<TACKY::Instruction> &insts = cfg.blocks[header - 1].insts;
+   if (insts.empty() || !(std::holds_alternative<TACKY::Jump>(insts.back()) || std::holds_alternative<TACKY::Return>(insts.back()))) {
+    insts.push_back(TACKY::Jump(header_label));
+   }
+  }
+
+  before[header] = added.size();
+  added.emplace_back();
+  added.back().insts.push_back(TACKY::Label(label));
+ }
+
+ if (added.empty()) return false;
+
+ std::vector<Block> blocks;
+ blocks.reserve(cfg.blocks.size() + added.size());
+ for (size_t b = 0; b < cfg.blocks.size(); b++) {
+  if (before[b] != CFG::exit) blocks.push_back(std::move(added[before[b]]));
+  blocks.push_back(std::move(cfg.blocks[b]));
+ }
+
+ cfg.blocks = std::move(blocks);
+ analyses.invalidate(Change::CFG);
+ find();
+ return true;
+}
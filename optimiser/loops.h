@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include "pass_manager.h"
+
+namespace Optimiser {
+ struct Loop {
+  size_t header;
+  // Every block of the loop, the header included, in layout order.
+  std::vector<size_t> blocks;
+  // The one block outside the loop that enters it, ending in a jump to the
+  // header or falling through to it, or CFG::exit if there is none.
+  size_t preheader;
+
+  bool contains(size_t block);
+ };
+
+ // The natural loops of a function: a back edge is one to a block that
+ // dominates its source, and its loop is every block that reaches the source
+ // without passing the header. Back edges to the same header make one loop.
+ // A loop nested in another is always smaller, so inner loops come first.
+ class Loops {
+  private:
+   FunctionAnalyses &analyses;
+
+   void find();
+
+  public:
+   std::vector<Loop> loops;
+
+   Loops() = delete;
+   Loops(FunctionAnalyses &analyses);
+
+   // Gives every loop without one a preheader, an empty block just before
+   // its header, and finds the loops again. Returns whether it changed the
+   // CFG.
+   bool insert_preheaders();
+ };
+}
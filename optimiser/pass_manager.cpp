@@ -0,0 +1,216 @@
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include "pass_manager.h"
+#include "passes.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+#include "../trace.h"
+#include "../helpers.h"
+
+static const Optimiser::Pass passes[] = {
+ {"verify", Optimiser::verify, true},
+ {"fold", Optimiser::fold_constants, true},
+ {"sccp", Optimiser::propagate_constants, false},
+ {"simplify", Optimiser::simplify, true},
+ {"copy-prop", Optimiser::propagate_copies, false},
+ {"dse", Optimiser::eliminate_dead_stores, false},
+ {"gvn", Optimiser::number_values, false},
+ {"licm", Optimiser::hoist_invariants, false},
+ {"jump-threading", Optimiser::thread_jumps, false},
+ {"simplify-cfg", Optimiser::simplify_cfg, true},
+};
+
+// A fixpoint group gives up after this many rounds.
+static const int max_rounds = 16;
+
+Optimiser::FunctionAnalyses::FunctionAnalyses(TACKY::Function &func, Parser::SymbolTable &symbols):
+ func(func),
+ symbols(symbols),
+ temporaries(SIZE_MAX) {}
+
+TACKY::Function &Optimiser::FunctionAnalyses::function() {
+ return func;
+}
+
+std::string Optimiser::FunctionAnalyses::name() {
+ return name_of(func.name);
+}
+
+bool Optimiser::FunctionAnalyses::is_static(const std::string &name) {
+ auto it = symbols.find(name);
+ return it != symbols.end() && it->second.type != Parser::Type::Function && it->second.attr_type == Parser::AttrType::Static;
+}
+
+// Names are "opt..N", which the resolver's "<name>.N" cannot produce since
+// "opt." is not an identifier. The first call skips past any an earlier run
+// left, wherever they appear.
+Token Optimiser::FunctionAnalyses::fresh_name() {
+ static const char prefix[] = "opt..";
+ static const size_t length = sizeof(prefix) - 1;
+
+ auto skip = [&](Token &name) {
+  if (name.length > length && strncmp(name.start, prefix, length) == 0) {
+   temporaries = std::max(temporaries, (size_t)strtoull(name.start + length, nullptr, 10) + 1);
+  }
+ };
+
+ if (temporaries == SIZE_MAX) {
+  temporaries = 0;
+  for (TACKY::Var &param : func.params) skip(param.name);
+  for (Block &block : cfg().blocks) {
+   for (TACKY::Instruction &inst : block.insts) for_each_name(inst, skip);
+  }
+ }
+
+ return make_name(prefix + std::to_string(temporaries++));
+}
+
+TACKY::Var Optimiser::FunctionAnalyses::temporary(Parser::Type type) {
+ TACKY::Var var(fresh_name());
+ var.type = type;
+
+ return var;
+}
+
+TACKY::Var Optimiser::FunctionAnalyses::label() {
+ return TACKY::Var(fresh_name());
+}
+
+Optimiser::CFG &Optimiser::FunctionAnalyses::cfg() {
+ if (!cfg_) cfg_ = std::make_unique<CFG>(func.body);
+ return *cfg_;
+}
+
+Optimiser::DominatorTree &Optimiser::FunctionAnalyses::dominators() {
+ if (!dominators_) dominators_ = std::make_unique<DominatorTree>(cfg());
+ return *dominators_;
+}
+
+// The blocks hold the only up-to-date copy of the body, so a changed CFG is
+// linearised and split again rather than patched.
+void Optimiser::FunctionAnalyses::invalidate(Change change) {
+ if (change != Change::CFG) return;
+
+ finish();
+ cfg_.reset();
+ dominators_.reset();
+}
+
+void Optimiser::FunctionAnalyses::finish() {
+ if (cfg_) func.body = cfg_->linearise();
+}
+
+Optimiser::PassManager::PassManager(std::string pipeline, bool time_passes) {
+ this->time_passes = time_passes;
+
+ size_t pos = 0;
+ this->pipeline = parse(pipeline, pos);
+ if (pos < pipeline.size()) error("Unexpected ')' in pass pipeline " + pipeline);
+}
+
+std::string Optimiser::PassManager::pipeline_for(int level) {
+ static const char *pipelines[] = {
+  // -O0
+  "",
+  // -O1
+  "fold,simplify,copy-prop,fold,dse,jump-threading,simplify-cfg",
+  // -O2
+  "fixpoint(sccp,fold,simplify,gvn,licm,copy-prop,dse,jump-threading,simplify-cfg)",
+ };
+
+ return pipelines[std::clamp(level, 0, 2)];
+}
+
+std::vector<Optimiser::PassManager::Step> Optimiser::PassManager::parse(const std::string &spec, size_t &pos) {
+ std::vector<Step> steps;
+
+ while (pos < spec.size() && spec[pos] != ')') {
+  size_t end = spec.find_first_of(",()", pos);
+  std::string name = spec.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+  pos = end == std::string::npos ? spec.size() : end;
+
+  if (name == "fixpoint" && pos < spec.size() && spec[pos] == '(') {
+   pos++;
+   steps.push_back({nullptr, parse(spec, pos)});
+   if (pos >= spec.size()) error("Missing ')' in pass pipeline " + spec);
+   pos++;
+  } else if (name != "") {
+   const Pass *found = nullptr;
+   for (const Pass &pass : passes) {
+    if (name == pass.name) found = &pass;
+   }
+
+   if (found == nullptr) error("Unknown pass " + name);
+   steps.push_back({found, {}});
+  }
+
+  if (pos < spec.size() && spec[pos] == ',') pos++;
+ }
+
+ return steps;
+}
+
+Optimiser::Change Optimiser::PassManager::run(const Pass &pass, FunctionAnalyses &analyses) {
+ auto start = std::chrono::steady_clock::now();
+ Change change = pass.run(analyses);
+ analyses.invalidate(change);
+
+ if (OptRecord::enabled) OptRecord::pass(pass.name, analyses.name(), analyses.cfg().size());
+ if (time_passes) {
+  Timing &timing = timings[&pass - passes];
+  timing.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  timing.runs++;
+  timing.changes += change != Change::None;
+ }
+
+ return change;
+}
+
+Optimiser::Change Optimiser::PassManager::run(std::vector<Step> &steps, FunctionAnalyses &analyses, Tier tier) {
+ Change changed = Change::None;
+
+ for (Step &step : steps) {
+  Change change = Change::None;
+  if (step.pass == nullptr) {
+   for (int round = 0; round < max_rounds; round++) {
+    Change round_change = run(step.group, analyses, tier);
+    if (round_change == Change::None) break;
+    change = std::max(change, round_change);
+   }
+  } else if (step.pass->linear || tier == Tier::Full) {
+   change = run(*step.pass, analyses);
+  }
+
+  changed = std::max(changed, change);
+ }
+
+ return changed;
+}
+
+void Optimiser::PassManager::run(TACKY::Program &program, Parser::SymbolTable &symbols) {
+ if (pipeline.empty()) return;
+
+ timings.clear();
+ for (const Pass &pass : passes) timings.push_back({pass.name, 0, 0, 0});
+
+ for (TACKY::Function &func : program.funcs) {
+  Trace::Scope scope("Optimise function", [&] {return func.name;});
+  Tier tier = Optimiser::tier(func, "pass-manager");
+  if (tier == Tier::None) continue;
+
+  FunctionAnalyses analyses(func, symbols);
+  run(pipeline, analyses, tier);
+  analyses.finish();
+ }
+
+ if (!time_passes) return;
+
+ fprintf(stderr, "%-24s %8s %8s %10s\n", "Pass", "Runs", "Changed", "ms");
+ for (Timing &timing : timings) {
+  if (timing.runs == 0) continue;
+  fprintf(stderr, "%-24s %8zu %8zu %10.3f\n", timing.name, timing.runs, timing.changes, timing.ms);
+ }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "cfg.h"
+#include "dominators.h"
+#include "budget.h"
+#include "../tacky/types.h"
+
+namespace Optimiser {
+ // What a pass did. Only a change to the CFG's edges invalidates the cached
+ // analyses; rewriting instructions within blocks keeps them.
+ enum class Change {
+  None,
+  Instructions,
+  CFG
+ };
+
+ // The analyses of one function, built on first use and kept until a pass
+ // changes what they describe.
+ class FunctionAnalyses {
+  private:
+   TACKY::Function &func;
+   Parser::SymbolTable &symbols;
+   std::unique_ptr<CFG> cfg_;
+   std::unique_ptr<DominatorTree> dominators_;
+   size_t temporaries;
+
+   Token fresh_name();
+
+  public:
+   FunctionAnalyses() = delete;
+   FunctionAnalyses(TACKY::Function &func, Parser::SymbolTable &symbols);
+
+   TACKY::Function &function();
+   std::string name();
+   // Whether a variable has static storage, so that any call may read or
+   // write it and it outlives the function.
+   bool is_static(const std::string &name);
+   // A new variable, named apart from every other in the function.
+   TACKY::Var temporary(Parser::Type type);
+   // A new label, named apart from the variables and the other labels.
+   TACKY::Var label();
+   CFG &cfg();
+   DominatorTree &dominators();
+   void invalidate(Change change);
+   // Writes the blocks back into the function's body.
+   void finish();
+ };
+
+ using PassFunction = Change (*)(FunctionAnalyses &analyses);
+
+ struct Pass {
+  const char *name;
+  PassFunction run;
+  // Linear in the size of the function, so allowed on one over budget.
+  bool linear;
+ };
+
+ // Runs a pipeline such as "a,b,fixpoint(c,d)" over every function. A
+ // fixpoint group repeats until none of its passes changes anything.
+ class PassManager {
+  private:
+   struct Step {
+    const Pass *pass;
+    std::vector<Step> group;
+   };
+
+   struct Timing {
+    const char *name;
+    double ms;
+    size_t runs, changes;
+   };
+
+   std::vector<Step> pipeline;
+   std::vector<Timing> timings;
+   bool time_passes;
+
+   std::vector<Step> parse(const std::string &spec, size_t &pos);
+   Change run(std::vector<Step> &steps, FunctionAnalyses &analyses, Tier tier);
+   Change run(const Pass &pass, FunctionAnalyses &analyses);
+
+  public:
+   PassManager() = delete;
+   PassManager(std::string pipeline, bool time_passes = false);
+
+   // The pipeline for -O<level>.
+   static std::string pipeline_for(int level);
+   void run(TACKY::Program &program, Parser::SymbolTable &symbols);
+ };
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "pass_manager.h"
+
+// Every pass, registered by name in pass_manager.cpp.
+namespace Optimiser {
+ Change verify(FunctionAnalyses &analyses);
+ Change fold_constants(FunctionAnalyses &analyses);
+ Change propagate_constants(FunctionAnalyses &analyses);
+ Change simplify(FunctionAnalyses &analyses);
+ Change propagate_copies(FunctionAnalyses &analyses);
+ Change eliminate_dead_stores(FunctionAnalyses &analyses);
+ Change number_values(FunctionAnalyses &analyses);
+ Change hoist_invariants(FunctionAnalyses &analyses);
+ Change thread_jumps(FunctionAnalyses &analyses);
+ Change simplify_cfg(FunctionAnalyses &analyses);
+}
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <unordered_map>
+#include "passes.h"
+#include "ssa.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+namespace {
+ // Top is a variable no executed definition has reached yet; bottom is one
+ // that can hold more than one value.
+ struct Lattice {
+  enum State {
+   Top,
+   Constant,
+   Bottom
+  } state = Top;
+  size_t val = 0;
+
+  bool operator==(const Lattice &other) const {return state == other.state && val == other.val;}
+ };
+}
+
+static Lattice meet(Lattice a, Lattice b) {
+ if (a.state == Lattice::Top) return b;
+ if (b.state == Lattice::Top) return a;
+ if (a.state == Lattice::Constant && a == b) return a;
+ return {Lattice::Bottom};
+}
+
+namespace {
+ class Propagator {
+  private:
+   Optimiser::SSA &ssa;
+   Optimiser::CFG &cfg;
+   std::unordered_map<std::string, Lattice> values;
+   bool changed;
+
+   bool mark(size_t block, size_t succ) {
+    if (succ == Optimiser::CFG::exit) return false;
+
+    std::vector<size_t> &preds = cfg.blocks[succ].preds;
+    size_t j = std::find(preds.begin(), preds.end(), block) - preds.begin();
+    if (executable[succ][j]) return false;
+
+    executable[succ][j] = true;
+    reached[succ] = true;
+    return changed = true;
+   }
+
+   void lower(TACKY::Var &dst, Lattice val) {
+    Lattice &old = values[name_of(dst.name)];
+    Lattice result = meet(old, val);
+    if (result == old) return;
+
+    old = result;
+    changed = true;
+   }
+
+   // An instruction's result from its operands' values.
+   Lattice evaluate(TACKY::Instruction &inst) {
+    if (std::holds_alternative<TACKY::FunCall>(inst)) return {Lattice::Bottom};
+
+    if (TACKY::Copy *copy = std::get_if<TACKY::Copy>(&inst); copy) {
+     Lattice src = value(copy->src);
+     Parser::Type type = Optimiser::type_of(copy->dst);
+     if (src.state != Lattice::Constant) return src;
+     if (Optimiser::bits(Optimiser::type_of(copy->src)) != Optimiser::bits(type)) return {Lattice::Bottom};
+     return {Lattice::Constant, Optimiser::wrap(src.val, type)};
+    }
+
+    TACKY::Instruction folded = inst;
+    bool top = false, bottom = false;
+    for_each_src(folded, [&](TACKY::Value &val) {
+     Lattice operand = value(val);
+     if (operand.state == Lattice::Constant) val = Optimiser::make_constant(operand.val, Optimiser::type_of(val));
+     top = top || operand.state == Lattice::Top;
+     bottom = bottom || operand.state == Lattice::Bottom;
+    });
+    if (bottom) return {Lattice::Bottom};
+    if (top) return {Lattice::Top};
+
+    size_t result;
+    if (!Optimiser::fold(folded, result)) return {Lattice::Bottom};
+    return {Lattice::Constant, Optimiser::wrap(result, Optimiser::type_of(*get_dst(inst)))};
+   }
+
+   void visit(size_t b) {
+    for (Optimiser::Phi &phi : ssa.phis[b]) {
+     Lattice val;
+     for (size_t j = 0; j < phi.args.size(); j++) {
+      if (executable[b][j]) val = meet(val, value(phi.args[j]));
+     }
+     lower(phi.dst, val);
+    }
+
+    std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+    for (TACKY::Instruction &inst : insts) {
+     TACKY::Value *dst = get_dst(inst);
+     if (dst && ssa.is_ssa(*dst)) lower(std::get<TACKY::Var>(*dst), evaluate(inst));
+    }
+
+    size_t next = b + 1 < cfg.blocks.size() ? b + 1 : Optimiser::CFG::exit;
+    TACKY::Instruction *last = insts.empty() ? nullptr : &insts.back();
+    TACKY::Var *target = last ? get_target(*last) : nullptr;
+    auto target_block = [&] {
+     auto it = cfg.labels.find(name_of(target->name));
+     return it == cfg.labels.end() ? Optimiser::CFG::exit : it->second;
+    };
+
+    if (last && std::holds_alternative<TACKY::Return>(*last)) return;
+    if (last && std::holds_alternative<TACKY::Jump>(*last)) {
+     mark(b, target_block());
+     return;
+    }
+    if (target == nullptr) {
+     mark(b, next);
+     return;
+    }
+
+    // Neither side of a branch on a top value runs yet.
+    Lattice cond = value(std::holds_alternative<TACKY::JumpIfZero>(*last) ? std::get<TACKY::JumpIfZero>(*last).val : std::get<TACKY::JumpIfNotZero>(*last).val);
+    bool jumps_if_zero = std::holds_alternative<TACKY::JumpIfZero>(*last);
+    if (cond.state == Lattice::Bottom || (cond.state == Lattice::Constant && (cond.val == 0) == jumps_if_zero)) mark(b, target_block());
+    if (cond.state == Lattice::Bottom || (cond.state == Lattice::Constant && (cond.val == 0) != jumps_if_zero)) mark(b, next);
+   }
+
+  public:
+   // Which of each block's incoming edges, in the order of its preds, and
+   // which blocks can run.
+   std::vector<std::vector<bool>> executable;
+   std::vector<bool> reached;
+
+   Propagator(Optimiser::SSA &ssa, Optimiser::CFG &cfg) : ssa(ssa), cfg(cfg) {
+    executable.resize(cfg.blocks.size());
+    for (size_t b = 0; b < cfg.blocks.size(); b++) executable[b].assign(cfg.blocks[b].preds.size(), false);
+    reached.assign(cfg.blocks.size(), false);
+    reached[0] = true;
+   }
+
+   // A variable that no instruction in SSA form defines, such as a
+   // parameter or a static variable, can hold anything.
+   Lattice value(TACKY::Value &val) {
+    if (TACKY::Constant *konst = std::get_if<TACKY::Constant>(&val); konst) {
+     return {Lattice::Constant, Optimiser::wrap(konst->_const, konst->type)};
+    }
+
+    auto it = values.find(name_of(std::get<TACKY::Var>(val).name));
+    return it == values.end() ? Lattice{Lattice::Bottom} : it->second;
+   }
+
+   void define(TACKY::Var &dst) {
+    values.emplace(name_of(dst.name), Lattice());
+   }
+
+   // Visits the blocks that can run in reverse postorder until nothing
+   // changes; values only ever fall, so this settles.
+   void run(std::vector<size_t> &rpo) {
+    for (changed = true; changed;) {
+     changed = false;
+     for (size_t b : rpo) {
+      if (reached[b]) visit(b);
+     }
+    }
+   }
+ };
+}
+
+// Wegman and Zadeck's sparse conditional constant propagation over SSA form:
+// a variable is constant if it is along every edge that can run, and an
+// edge can run only if the branch before it can go that way.
+Optimiser::Change Optimiser::propagate_constants(FunctionAnalyses &analyses) {
+ std::vector<TACKY::Instruction> before = analyses.cfg().linearise();
+ SSA ssa(analyses);
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ Propagator propagator(ssa, cfg);
+
+ for (size_t b : dominators.rpo) {
+  for (Phi &phi : ssa.phis[b]) propagator.define(phi.dst);
+  for (TACKY::Instruction &inst : cfg.blocks[b].insts) {
+   TACKY::Value *dst = get_dst(inst);
+   if (dst && ssa.is_ssa(*dst)) propagator.define(std::get<TACKY::Var>(*dst));
+  }
+ }
+ propagator.run(dominators.rpo);
+
+ size_t replaced = 0, branches = 0;
+ auto constant = [&](TACKY::Value &val) {
+  Lattice value = propagator.value(val);
+  if (value.state != Lattice::Constant || !std::holds_alternative<TACKY::Var>(val)) return false;
+
+  val = make_constant(value.val, type_of(val));
+  return true;
+ };
+
+ for (size_t b : dominators.rpo) {
+  if (!propagator.reached[b]) continue;
+
+  std::vector<Phi> &phis = ssa.phis[b];
+  for (size_t i = 0; i < phis.size();) {
+   TACKY::Value dst = phis[i].dst;
+   if (propagator.value(dst).state == Lattice::Constant) {
+    phis.erase(phis.begin() + i);
+    replaced++;
+    continue;
+   }
+
+   for (size_t j = 0; j < phis[i].args.size(); j++) {
+    if (propagator.executable[b][j] && constant(phis[i].args[j])) replaced++;
+   }
+   i++;
+  }
+
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  for (size_t i = 0; i < insts.size(); i++) {
+   for_each_src(insts[i], [&](TACKY::Value &val) {replaced += constant(val);});
+
+   TACKY::Value *dst = get_dst(insts[i]);
+   TACKY::Copy *copy = std::get_if<TACKY::Copy>(&insts[i]);
+   Lattice value = dst && ssa.is_ssa(*dst) ? propagator.value(*dst) : Lattice{Lattice::Bottom};
+   if (value.state == Lattice::Constant && !(copy && std::holds_alternative<TACKY::Constant>(copy->src))) {
+    TACKY::Value var = *dst;
+    insts[i] = TACKY::Copy(make_constant(value.val, type_of(var)), var);
+    replaced++;
+    continue;
+   }
+
+   TACKY::Value *cond = nullptr;
+   bool jumps_if_zero = std::holds_alternative<TACKY::JumpIfZero>(insts[i]);
+   if (jumps_if_zero) cond = &std::get<TACKY::JumpIfZero>(insts[i]).val;
+   if (TACKY::JumpIfNotZero *jump = std::get_if<TACKY::JumpIfNotZero>(&insts[i]); jump) cond = &jump->val;
+   if (cond == nullptr || !std::holds_alternative<TACKY::Constant>(*cond)) continue;
+
+   TACKY::Constant &konst = std::get<TACKY::Constant>(*cond);
+   if ((wrap(konst._const, konst.type) == 0) == jumps_if_zero) {
+    insts[i] = TACKY::Jump(*get_target(insts[i]));
+   } else {
+    insts.erase(insts.begin() + i);
+    i--;
+   }
+   branches++;
+  }
+ }
+
+ if (replaced + branches == 0) {
+  cfg = CFG(before);
+  analyses.invalidate(Change::CFG);
+  return Change::None;
+ }
+
+ ssa.reconnect();
+ ssa.leave();
+
+ OptRecord::remark(analyses.name(), "sccp", true,
+  "replaced " + std::to_string(replaced) + " values with constants and removed " + std::to_string(branches) + " branches");
+ return Change::CFG;
+}
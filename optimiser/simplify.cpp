@@ -0,0 +1,441 @@
+#include <unordered_map>
+#include "passes.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+using Parser::BinaryOp;
+using Parser::UnaryOp;
+
+static TACKY::Var *var_of(TACKY::Value &val) {
+ return std::get_if<TACKY::Var>(&val);
+}
+
+static bool is_constant(TACKY::Value &val, size_t num, Parser::Type type) {
+ TACKY::Constant *konst = std::get_if<TACKY::Constant>(&val);
+ return konst && Optimiser::wrap(konst->_const, konst->type) == Optimiser::wrap(num, type);
+}
+
+static bool same_var(TACKY::Value &a, TACKY::Value &b) {
+ TACKY::Var *var_a = var_of(a), *var_b = var_of(b);
+ return var_a && var_b && name_of(var_a->name) == name_of(var_b->name);
+}
+
+static bool same_size(Parser::Type a, Parser::Type b) {
+ return get_type_size(a) == get_type_size(b);
+}
+
+static bool is_associative(BinaryOp op) {
+ return op == BinaryOp::Addition || op == BinaryOp::Multiply || op == BinaryOp::Bitwise_And ||
+        op == BinaryOp::Bitwise_Or || op == BinaryOp::Exclusive_Or;
+}
+
+static BinaryOp inverse(BinaryOp op) {
+ switch (op) {
+  case BinaryOp::Equal:            return BinaryOp::Not_Equal;
+  case BinaryOp::Not_Equal:        return BinaryOp::Equal;
+  case BinaryOp::Less_Than:        return BinaryOp::Greater_Or_Equal;
+  case BinaryOp::Less_Or_Equal:    return BinaryOp::Greater_Than;
+  case BinaryOp::Greater_Than:     return BinaryOp::Less_Or_Equal;
+  case BinaryOp::Greater_Or_Equal: return BinaryOp::Less_Than;
+  default:                         return BinaryOp::Error;
+ }
+}
+
+static TACKY::Binary make_binary(BinaryOp op, TACKY::Value src1, TACKY::Value src2, TACKY::Value dst) {
+ TACKY::Binary binary(src1, src2, dst);
+ binary.op = op;
+
+ return binary;
+}
+
+namespace {
+ // The instructions of one block whose results still hold: nothing they
+ // read has been written since, and no call has run if they touch statics.
+ class Available {
+  private:
+   struct Def {
+    size_t index;
+    std::vector<std::pair<std::string, size_t>> reads;
+    bool calls_clobber;
+    size_t calls;
+   };
+
+   Optimiser::FunctionAnalyses &analyses;
+   std::unordered_map<std::string, size_t> versions;
+   std::unordered_map<std::string, Def> defs;
+   size_t calls = 0;
+
+  public:
+   Available(Optimiser::FunctionAnalyses &analyses) : analyses(analyses) {}
+
+   void define(TACKY::Instruction &inst, size_t index) {
+    TACKY::Value *dst = get_dst(inst);
+    TACKY::Var *var = dst ? var_of(*dst) : nullptr;
+    if (std::holds_alternative<TACKY::FunCall>(inst)) calls++;
+    if (var == nullptr) return;
+
+    std::string name = name_of(var->name);
+    Def def = {index, {}, analyses.is_static(name), calls};
+    for_each_src(inst, [&](TACKY::Value &val) {
+     TACKY::Var *src = var_of(val);
+     if (src == nullptr) return;
+
+     std::string src_name = name_of(src->name);
+     def.reads.push_back({src_name, versions[src_name]});
+     def.calls_clobber = def.calls_clobber || analyses.is_static(src_name);
+    });
+
+    versions[name]++;
+    if (std::holds_alternative<TACKY::Unary>(inst) || std::holds_alternative<TACKY::Binary>(inst)) defs[name] = def;
+    else defs.erase(name);
+   }
+
+   // Where the current value of `name` was computed, or SIZE_MAX.
+   size_t find(const std::string &name) {
+    auto it = defs.find(name);
+    if (it == defs.end() || (it->second.calls_clobber && it->second.calls != calls)) return SIZE_MAX;
+
+    for (auto &[read, version] : it->second.reads) {
+     if (versions[read] != version) return SIZE_MAX;
+    }
+
+    return it->second.index;
+   }
+ };
+
+ class Simplifier {
+  private:
+   Optimiser::FunctionAnalyses &analyses;
+   std::unordered_map<std::string, size_t> uses, defs;
+   // The single user in the current block of each variable read once, when
+   // that user is a Binary; a chain is only rebuilt from its top.
+   std::unordered_map<std::string, TACKY::Binary *> users;
+   std::vector<TACKY::Instruction> out;
+   std::vector<bool> removed;
+
+   void count(TACKY::Instruction &inst, int delta) {
+    for_each_src(inst, [&](TACKY::Value &val) {
+     if (TACKY::Var *var = var_of(val); var) uses[name_of(var->name)] += delta;
+    });
+   }
+
+   void emit(TACKY::Instruction inst, Available &available) {
+    out.push_back(inst);
+    removed.push_back(false);
+    available.define(out.back(), out.size() - 1);
+   }
+
+   TACKY::Instruction *available_def(TACKY::Value &val, Available &available) {
+    TACKY::Var *var = var_of(val);
+    size_t index = var ? available.find(name_of(var->name)) : SIZE_MAX;
+    return index == SIZE_MAX || removed[index] ? nullptr : &out[index];
+   }
+
+   bool identity(TACKY::Instruction &inst, Available &available);
+   bool identity(TACKY::Binary &binary, TACKY::Instruction &inst);
+   bool reassociate(TACKY::Binary root, Available &available);
+   void strength_reduce(TACKY::Instruction &inst);
+
+  public:
+   size_t simplified = 0, reassociated = 0;
+
+   Simplifier(Optimiser::FunctionAnalyses &analyses);
+   void run(Optimiser::Block &block);
+ };
+}
+
+Simplifier::Simplifier(Optimiser::FunctionAnalyses &analyses) : analyses(analyses) {
+ for (Optimiser::Block &block : analyses.cfg().blocks) {
+  for (TACKY::Instruction &inst : block.insts) {
+   count(inst, 1);
+   TACKY::Value *dst = get_dst(inst);
+   if (TACKY::Var *var = dst ? var_of(*dst) : nullptr; var) defs[name_of(var->name)]++;
+  }
+ }
+}
+
+// Rewrites an instruction that an identity makes trivial into a copy, a
+// constant or a cheaper operation.
+bool Simplifier::identity(TACKY::Binary &binary, TACKY::Instruction &inst) {
+ Parser::Type type = Optimiser::type_of(binary.dst);
+ TACKY::Value &a = binary.src1, &b = binary.src2;
+ size_t ones = Optimiser::wrap(~size_t(0), type);
+ auto copy = [&](TACKY::Value val) {
+  if (TACKY::Constant *konst = std::get_if<TACKY::Constant>(&val); konst) val = Optimiser::make_constant(konst->_const, type);
+  inst = TACKY::Copy(val, binary.dst);
+  return true;
+ };
+ auto constant = [&](size_t num) {return copy(Optimiser::make_constant(num, type));};
+
+ if (inverse(binary.op) != BinaryOp::Error) {
+  if (!same_var(a, b)) return false;
+
+  BinaryOp op = binary.op;
+  return constant(op == BinaryOp::Equal || op == BinaryOp::Less_Or_Equal || op == BinaryOp::Greater_Or_Equal);
+ }
+
+ if (binary.op == BinaryOp::Shift_Left || binary.op == BinaryOp::Shift_Right) {
+  return same_size(Optimiser::type_of(a), type) && is_constant(b, 0, Optimiser::type_of(b)) && copy(a);
+ }
+
+ if (!same_size(Optimiser::type_of(a), type) || !same_size(Optimiser::type_of(b), type)) return false;
+
+ switch (binary.op) {
+  case BinaryOp::Addition:
+   if (is_constant(b, 0, type)) return copy(a);
+   if (is_constant(a, 0, type)) return copy(b);
+   break;
+  case BinaryOp::Subtract:
+   if (is_constant(b, 0, type)) return copy(a);
+   if (same_var(a, b)) return constant(0);
+   break;
+  case BinaryOp::Multiply:
+   if (is_constant(b, 1, type)) return copy(a);
+   if (is_constant(a, 1, type)) return copy(b);
+   if (is_constant(a, 0, type) || is_constant(b, 0, type)) return constant(0);
+   break;
+  case BinaryOp::Divide:
+   if (is_constant(b, 1, type)) return copy(a);
+   break;
+  case BinaryOp::Remainder:
+   if (is_constant(b, 1, type)) return constant(0);
+   break;
+  case BinaryOp::Bitwise_And:
+   if (is_constant(b, ones, type) || same_var(a, b)) return copy(a);
+   if (is_constant(a, ones, type)) return copy(b);
+   if (is_constant(a, 0, type) || is_constant(b, 0, type)) return constant(0);
+   break;
+  case BinaryOp::Bitwise_Or:
+   if (is_constant(b, 0, type) || same_var(a, b)) return copy(a);
+   if (is_constant(a, 0, type)) return copy(b);
+   if (is_constant(a, ones, type) || is_constant(b, ones, type)) return constant(ones);
+   break;
+  case BinaryOp::Exclusive_Or:
+   if (is_constant(b, 0, type)) return copy(a);
+   if (is_constant(a, 0, type)) return copy(b);
+   if (same_var(a, b)) return constant(0);
+   break;
+  default: break;
+ }
+
+ return false;
+}
+
+bool Simplifier::identity(TACKY::Instruction &inst, Available &available) {
+ if (TACKY::Binary *binary = std::get_if<TACKY::Binary>(&inst); binary) return identity(*binary, inst);
+
+ TACKY::Unary *unary = std::get_if<TACKY::Unary>(&inst);
+ TACKY::Instruction *def = unary ? available_def(unary->src, available) : nullptr;
+ if (def == nullptr) return false;
+
+ Parser::Type type = Optimiser::type_of(unary->dst);
+ TACKY::Unary *inner = std::get_if<TACKY::Unary>(def);
+ TACKY::Binary *compare = std::get_if<TACKY::Binary>(def);
+
+ if (unary->op == UnaryOp::Not && inner && inner->op == UnaryOp::Not) {
+  // !!x is x != 0.
+  TACKY::Value src = inner->src;
+  inst = make_binary(BinaryOp::Not_Equal, src, Optimiser::make_constant(0, Optimiser::type_of(src)), unary->dst);
+  return true;
+ }
+
+ if (unary->op == UnaryOp::Not && compare && inverse(compare->op) != BinaryOp::Error) {
+  inst = make_binary(inverse(compare->op), compare->src1, compare->src2, unary->dst);
+  return true;
+ }
+
+ bool involution = unary->op == UnaryOp::Negate || unary->op == UnaryOp::Complement;
+ if (involution && inner && inner->op == unary->op && Optimiser::type_of(inner->src) == type &&
+     Optimiser::type_of(inner->dst) == type) {
+  inst = TACKY::Copy(inner->src, unary->dst);
+  return true;
+ }
+
+ return false;
+}
+
+// Flattens a tree of one associative operator whose inner results are
+// temporaries used nowhere else, folds its constants together and rebuilds
+// it balanced, so independent halves can execute in parallel.
+bool Simplifier::reassociate(TACKY::Binary root, Available &available) {
+ Parser::Type type = Optimiser::type_of(root.dst);
+ BinaryOp op = root.op;
+ auto same_type = [&](TACKY::Binary &binary) {
+  return Optimiser::type_of(binary.src1) == type && Optimiser::type_of(binary.src2) == type &&
+         Optimiser::type_of(binary.dst) == type;
+ };
+ if (!is_associative(op) || !same_type(root)) return false;
+
+ std::vector<TACKY::Value> leaves;
+ std::vector<size_t> constants, interior;
+ size_t depth = 0;
+ std::vector<std::pair<TACKY::Value, size_t>> work = {{root.src2, 1}, {root.src1, 1}};
+
+ while (!work.empty()) {
+  auto [val, level] = work.back();
+  work.pop_back();
+
+  if (TACKY::Constant *konst = std::get_if<TACKY::Constant>(&val); konst) {
+   constants.push_back(Optimiser::wrap(konst->_const, type));
+   continue;
+  }
+
+  std::string name = name_of(var_of(val)->name);
+  TACKY::Instruction *def = uses[name] == 1 && defs[name] == 1 && !analyses.is_static(name) ? available_def(val, available) : nullptr;
+  TACKY::Binary *inner = def ? std::get_if<TACKY::Binary>(def) : nullptr;
+
+  if (inner && inner->op == op && same_type(*inner)) {
+   interior.push_back(def - out.data());
+   work.push_back({inner->src2, level + 1});
+   work.push_back({inner->src1, level + 1});
+  } else {
+   leaves.push_back(val);
+   depth = std::max(depth, level);
+  }
+ }
+
+ bool has_constant = !constants.empty();
+ size_t konst = has_constant ? constants[0] : 0;
+ for (size_t i = 1; i < constants.size(); i++) {
+  TACKY::Binary combine = make_binary(op, Optimiser::make_constant(konst, type), Optimiser::make_constant(constants[i], type), root.dst);
+  Optimiser::fold_binary(combine, konst, constants[i], konst);
+ }
+
+ size_t ones = Optimiser::wrap(~size_t(0), type);
+ bool absorbed = has_constant && ((op == BinaryOp::Multiply && konst == 0) || (op == BinaryOp::Bitwise_And && konst == 0) ||
+                                  (op == BinaryOp::Bitwise_Or && konst == ones));
+ bool neutral = has_constant && ((op == BinaryOp::Multiply && konst == 1) || (op == BinaryOp::Bitwise_And && konst == ones) ||
+                                 (op != BinaryOp::Multiply && op != BinaryOp::Bitwise_And && konst == 0));
+ if (absorbed) leaves.clear();
+ if (neutral) has_constant = false;
+
+ size_t balanced = has_constant;
+ for (size_t width = 1; width < leaves.size(); width *= 2) balanced++;
+ if (constants.size() < 2 && !absorbed && !neutral && balanced >= depth) return false;
+
+ // The leaves are read again by the new tree.
+ TACKY::Instruction old = root;
+ count(old, -1);
+ for (size_t index : interior) {
+  count(out[index], -1);
+  removed[index] = true;
+ }
+
+ TACKY::Value dst = root.dst;
+ while (leaves.size() > 2 || (leaves.size() == 2 && has_constant)) {
+  std::vector<TACKY::Value> next;
+  for (size_t i = 0; i < leaves.size(); i += 2) {
+   if (i + 1 == leaves.size()) {
+    next.push_back(leaves[i]);
+    continue;
+   }
+
+   TACKY::Var tmp = analyses.temporary(type);
+   uses[name_of(tmp.name)] = defs[name_of(tmp.name)] = 1;
+   emit(make_binary(op, leaves[i], leaves[i + 1], tmp), available);
+   count(out.back(), 1);
+   next.push_back(tmp);
+  }
+  leaves = next;
+ }
+
+ TACKY::Instruction last = TACKY::Copy(Optimiser::make_constant(konst, type), dst);
+ if (leaves.size() == 2) last = make_binary(op, leaves[0], leaves[1], dst);
+ else if (leaves.size() == 1 && has_constant) last = make_binary(op, leaves[0], Optimiser::make_constant(konst, type), dst);
+ else if (leaves.size() == 1) last = TACKY::Copy(leaves[0], dst);
+
+ strength_reduce(last);
+ emit(last, available);
+ count(out.back(), 1);
+ return true;
+}
+
+// x * 2^k is x << k.
+void Simplifier::strength_reduce(TACKY::Instruction &inst) {
+ TACKY::Binary *binary = std::get_if<TACKY::Binary>(&inst);
+ if (binary == nullptr || binary->op != BinaryOp::Multiply) return;
+
+ TACKY::Constant *konst = std::get_if<TACKY::Constant>(&binary->src2);
+ size_t factor = konst ? Optimiser::wrap(konst->_const, konst->type) : 0;
+ if (factor < 2 || (factor & (factor - 1)) != 0 || !var_of(binary->src1)) return;
+ if (!same_size(Optimiser::type_of(binary->src1), Optimiser::type_of(binary->dst))) return;
+
+ binary->op = BinaryOp::Shift_Left;
+ binary->src2 = Optimiser::make_constant(__builtin_ctzll(factor), Parser::Type::Int);
+ simplified++;
+}
+
+void Simplifier::run(Optimiser::Block &block) {
+ out.clear();
+ removed.clear();
+ users.clear();
+ Available available(analyses);
+
+ for (TACKY::Instruction &inst : block.insts) {
+  TACKY::Binary *binary = std::get_if<TACKY::Binary>(&inst);
+  if (binary == nullptr) continue;
+
+  // x - c is x + -c, so that it joins a chain of additions.
+  TACKY::Constant *konst = std::get_if<TACKY::Constant>(&binary->src2);
+  Parser::Type type = Optimiser::type_of(binary->dst);
+  if (binary->op == BinaryOp::Subtract && konst && var_of(binary->src1) && same_size(konst->type, type) &&
+      same_size(Optimiser::type_of(binary->src1), type)) {
+   binary->op = BinaryOp::Addition;
+   binary->src2 = Optimiser::make_constant(0 - konst->_const, type);
+  }
+
+  for (TACKY::Value *src : {&binary->src1, &binary->src2}) {
+   TACKY::Var *var = var_of(*src);
+   if (var && uses[name_of(var->name)] == 1) users[name_of(var->name)] = binary;
+  }
+ }
+
+ for (TACKY::Instruction &inst : block.insts) {
+  TACKY::Instruction rewritten = inst;
+  if (identity(rewritten, available)) {
+   count(inst, -1);
+   count(rewritten, 1);
+   simplified++;
+  }
+
+  TACKY::Binary *binary = std::get_if<TACKY::Binary>(&rewritten);
+  TACKY::Var *dst = binary ? var_of(binary->dst) : nullptr;
+  auto user = dst ? users.find(name_of(dst->name)) : users.end();
+  bool top = user == users.end() || user->second->op != binary->op ||
+             Optimiser::type_of(user->second->dst) != Optimiser::type_of(binary->dst);
+
+  if (binary && top) {
+   if (reassociate(*binary, available)) {
+    reassociated++;
+    continue;
+   }
+
+   strength_reduce(rewritten);
+  }
+
+  emit(rewritten, available);
+ }
+
+ std::vector<TACKY::Instruction> insts;
+ insts.reserve(out.size());
+ for (size_t i = 0; i < out.size(); i++) {
+  if (!removed[i]) insts.push_back(std::move(out[i]));
+ }
+
+ block.insts = std::move(insts);
+}
+
+// Applies algebraic identities and reassociates chains of associative
+// operators, within each block.
+Optimiser::Change Optimiser::simplify(FunctionAnalyses &analyses) {
+ Simplifier simplifier(analyses);
+ for (Block &block : analyses.cfg().blocks) simplifier.run(block);
+
+ if (simplifier.simplified + simplifier.reassociated == 0) return Change::None;
+
+ OptRecord::remark(analyses.name(), "simplify", true,
+  "simplified " + std::to_string(simplifier.simplified) + " instructions and reassociated " +
+  std::to_string(simplifier.reassociated) + " expressions");
+ return Change::Instructions;
+}
@@ -0,0 +1,213 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "passes.h"
+#include "../tacky/util.h"
+#include "../opt_record.h"
+
+// A block of nothing but labels and a jump only passes control on.
+static TACKY::Jump *trampoline(Optimiser::Block &block) {
+ if (block.insts.empty()) return nullptr;
+
+ for (size_t i = 0; i + 1 < block.insts.size(); i++) {
+  if (!std::holds_alternative<TACKY::Label>(block.insts[i])) return nullptr;
+ }
+ return std::get_if<TACKY::Jump>(&block.insts.back());
+}
+
+namespace {
+ struct Counts {
+  size_t blocks = 0, jumps = 0, retargeted = 0, inverted = 0, labels = 0;
+ };
+}
+
+static bool remove_unreachable(Optimiser::CFG &cfg, Counts &counts) {
+ std::vector<bool> reachable(cfg.blocks.size(), false);
+ std::vector<size_t> work = {0};
+ reachable[0] = true;
+
+ while (!work.empty()) {
+  size_t b = work.back();
+  work.pop_back();
+
+  for (size_t succ : cfg.blocks[b].succs) {
+   if (succ == Optimiser::CFG::exit || reachable[succ]) continue;
+   reachable[succ] = true;
+   work.push_back(succ);
+  }
+ }
+
+ // A reachable block never falls through into an unreachable one, so
+ // dropping them leaves every other edge as it was.
+ bool changed = false;
+ for (size_t b = 0; b < cfg.blocks.size(); b++) {
+  if (reachable[b] || cfg.blocks[b].insts.empty()) continue;
+
+  cfg.blocks[b].insts.clear();
+  counts.blocks++;
+  changed = true;
+ }
+
+ return changed;
+}
+
+// Where a jump to `label` ends up after any chain of blocks that only jump
+// on. Every label on the way is given the same end, so each is followed
+// once however many jumps share the chain. A cycle of such blocks ends
+// where the walk first comes back round.
+static TACKY::Var final_target(Optimiser::CFG &cfg, TACKY::Var label, std::unordered_map<std::string, TACKY::Var> &ends) {
+ std::vector<std::string> path;
+ std::unordered_set<std::string> on_path;
+ TACKY::Var end = label;
+
+ while (true) {
+  std::string name = name_of(end.name);
+  if (auto it = ends.find(name); it != ends.end()) {
+   end = it->second;
+   break;
+  }
+  if (!on_path.insert(name).second) break;
+  path.push_back(name);
+
+  auto it = cfg.labels.find(name);
+  TACKY::Jump *next = it == cfg.labels.end() ? nullptr : trampoline(cfg.blocks[it->second]);
+  if (next == nullptr) break;
+
+  end = next->target;
+ }
+
+ for (std::string &name : path) ends.insert_or_assign(name, end);
+ return end;
+}
+
+// Points each jump past any chain of blocks that only jump on.
+static bool retarget_jumps(Optimiser::CFG &cfg, Counts &counts) {
+ std::unordered_map<std::string, TACKY::Var> ends;
+ bool changed = false;
+
+ for (Optimiser::Block &block : cfg.blocks) {
+  TACKY::Var *target = block.insts.empty() ? nullptr : get_target(block.insts.back());
+  if (target == nullptr) continue;
+
+  TACKY::Var end = final_target(cfg, *target, ends);
+  if (name_of(end.name) != name_of(target->name)) {
+   *target = end;
+   counts.retargeted++;
+   changed = true;
+  }
+ }
+
+ return changed;
+}
+
+// "if (x) goto a; goto b; a:" is "if (!x) goto b; a:".
+static bool invert_branches(Optimiser::CFG &cfg, Counts &counts) {
+ bool changed = false;
+
+ for (size_t b = 0; b + 2 < cfg.blocks.size(); b++) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  std::vector<TACKY::Instruction> &next = cfg.blocks[b + 1].insts;
+  if (insts.empty() || next.size() != 1 || !std::holds_alternative<TACKY::Jump>(next[0])) continue;
+
+  TACKY::Instruction &last = insts.back();
+  TACKY::Var *target = get_target(last);
+  auto it = target ? cfg.labels.find(name_of(target->name)) : cfg.labels.end();
+  if (std::holds_alternative<TACKY::Jump>(last) || it == cfg.labels.end() || it->second != b + 2) continue;
+
+  TACKY::Var other = std::get<TACKY::Jump>(next[0]).target;
+  if (TACKY::JumpIfZero *jump = std::get_if<TACKY::JumpIfZero>(&last); jump) last = TACKY::JumpIfNotZero(jump->val, other);
+  else if (TACKY::JumpIfNotZero *jump = std::get_if<TACKY::JumpIfNotZero>(&last); jump) last = TACKY::JumpIfZero(jump->val, other);
+
+  next.clear();
+  counts.inverted++;
+  changed = true;
+ }
+
+ return changed;
+}
+
+static bool remove_fall_through_jumps(Optimiser::CFG &cfg, Counts &counts) {
+ bool changed = false;
+
+ for (size_t b = 0; b < cfg.blocks.size(); b++) {
+  std::vector<TACKY::Instruction> &insts = cfg.blocks[b].insts;
+  TACKY::Var *target = insts.empty() ? nullptr : get_target(insts.back());
+  if (target == nullptr) continue;
+
+  // The next block that has any instructions is where control falls.
+  size_t next = b + 1;
+  while (next < cfg.blocks.size() && cfg.blocks[next].insts.empty()) next++;
+
+  auto it = cfg.labels.find(name_of(target->name));
+  if (it == cfg.labels.end() || it->second != next) continue;
+
+  insts.pop_back();
+  counts.jumps++;
+  changed = true;
+ }
+
+ return changed;
+}
+
+static bool remove_unused_labels(Optimiser::CFG &cfg, Counts &counts) {
+ std::unordered_map<std::string, size_t> uses;
+ for (Optimiser::Block &block : cfg.blocks) {
+  for (TACKY::Instruction &inst : block.insts) {
+   if (TACKY::Var *target = get_target(inst); target) uses[name_of(target->name)]++;
+  }
+ }
+
+ bool changed = false;
+ for (Optimiser::Block &block : cfg.blocks) {
+  std::vector<TACKY::Instruction> &insts = block.insts;
+  size_t kept = 0;
+
+  for (size_t i = 0; i < insts.size(); i++) {
+   TACKY::Label *label = std::get_if<TACKY::Label>(&insts[i]);
+   if (label && !uses.count(name_of(label->name.name))) {
+    counts.labels++;
+    changed = true;
+    continue;
+   }
+
+   if (kept != i) insts[kept] = std::move(insts[i]);
+   kept++;
+  }
+  insts.resize(kept);
+ }
+
+ return changed;
+}
+
+// Deletes unreachable blocks, jumps to the block that follows anyway and
+// labels nothing jumps to, points jumps past blocks that only jump on, and
+// inverts a branch over an unconditional jump. Blocks left joined by a
+// fall-through with no label between them are merged when the CFG is
+// rebuilt.
+Optimiser::Change Optimiser::simplify_cfg(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ Counts counts;
+ bool changed = false;
+
+ for (bool round_changed = true; round_changed;) {
+  round_changed = remove_unreachable(cfg, counts);
+  if (!round_changed) {
+   round_changed = retarget_jumps(cfg, counts) | invert_branches(cfg, counts);
+   round_changed = remove_fall_through_jumps(cfg, counts) | round_changed;
+   round_changed = remove_unused_labels(cfg, counts) | round_changed;
+  }
+
+  if (round_changed) {
+   std::vector<TACKY::Instruction> body = cfg.linearise();
+   cfg = CFG(body);
+   changed = true;
+  }
+ }
+
+ if (!changed) return Change::None;
+
+ OptRecord::remark(analyses.name(), "simplify-cfg", true,
+  "removed " + std::to_string(counts.blocks) + " unreachable blocks, " + std::to_string(counts.jumps) + " jumps and " +
+  std::to_string(counts.labels) + " labels; retargeted " + std::to_string(counts.retargeted) + " jumps and inverted " +
+  std::to_string(counts.inverted) + " branches");
+ return Change::CFG;
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <unordered_map>
+#include "ssa.h"
+#include "liveness.h"
+#include "../tacky/util.h"
+
+Optimiser::SSA::SSA(FunctionAnalyses &analyses) : analyses(analyses) {
+ // The entry block cannot have phis, as entering the function is not an
+ // edge to copy on, so one that is also a loop header gets a block before
+ // it.
+ if (!analyses.cfg().blocks[0].preds.empty()) {
+  TACKY::Var entry = analyses.label();
+  analyses.invalidate(Change::CFG);
+
+  std::vector<TACKY::Instruction> &body = analyses.function().body;
+  body.insert(body.begin(), TACKY::Label(entry));
+ }
+
+ phis.resize(analyses.cfg().blocks.size());
+ place_phis();
+ rename();
+}
+
+bool Optimiser::SSA::is_ssa(TACKY::Value &val) {
+ TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+ return var && !analyses.is_static(name_of(var->name));
+}
+
+void Optimiser::SSA::place_phis() {
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ std::vector<std::vector<size_t>> &frontiers = dominators.frontiers(cfg);
+ Liveness liveness(analyses);
+
+ // The blocks defining each variable, in the order variables are first seen.
+ std::vector<TACKY::Var> vars;
+ std::unordered_map<std::string, std::vector<size_t>> defs;
+ for (size_t b : dominators.rpo) {
+  for (TACKY::Instruction &inst : cfg.blocks[b].insts) {
+   TACKY::Value *dst = get_dst(inst);
+   if (dst == nullptr || !is_ssa(*dst)) continue;
+
+   TACKY::Var &var = std::get<TACKY::Var>(*dst);
+   std::vector<size_t> &blocks = defs[name_of(var.name)];
+   if (blocks.empty()) vars.push_back(var);
+   if (blocks.empty() || blocks.back() != b) blocks.push_back(b);
+  }
+ }
+
+ // Stamped with the variable's position in `vars`, to avoid clearing.
+ std::vector<size_t> has_phi(cfg.blocks.size(), SIZE_MAX), queued(cfg.blocks.size(), SIZE_MAX);
+ for (size_t v = 0; v < vars.size(); v++) {
+  std::string name = name_of(vars[v].name);
+  size_t bit = liveness.index.at(name);
+  std::vector<size_t> work = defs[name];
+  for (size_t b : work) queued[b] = v;
+
+  while (!work.empty()) {
+   size_t b = work.back();
+   work.pop_back();
+
+   for (size_t frontier : frontiers[b]) {
+    if (has_phi[frontier] == v || !liveness.live_in[frontier].test(bit)) continue;
+
+    has_phi[frontier] = v;
+    phis[frontier].push_back({vars[v], std::vector<TACKY::Value>(cfg.blocks[frontier].preds.size(), vars[v])});
+    if (queued[frontier] != v) {
+     queued[frontier] = v;
+     work.push_back(frontier);
+    }
+   }
+  }
+ }
+}
+
+// Walks the dominator tree with a stack of the current name of each
+// variable. A phi's arguments start as the variable's own name and are
+// renamed from the predecessor they come from.
+void Optimiser::SSA::rename() {
+ CFG &cfg = analyses.cfg();
+ DominatorTree &dominators = analyses.dominators();
+ std::unordered_map<std::string, std::vector<Token>> current;
+
+ auto use = [&](TACKY::Value &val) {
+  if (!is_ssa(val)) return;
+
+  TACKY::Var &var = std::get<TACKY::Var>(val);
+  auto it = current.find(name_of(var.name));
+  if (it != current.end() && !it->second.empty()) var.name = it->second.back();
+ };
+
+ auto define = [&](TACKY::Var &var, std::vector<std::string> &pushed) {
+  std::string name = name_of(var.name);
+  var.name = analyses.temporary(var.type).name;
+  current[name].push_back(var.name);
+  pushed.push_back(name);
+ };
+
+ auto enter = [&](size_t b, std::vector<std::string> &pushed) {
+  for (Phi &phi : phis[b]) define(phi.dst, pushed);
+
+  for (TACKY::Instruction &inst : cfg.blocks[b].insts) {
+   for_each_src(inst, use);
+   TACKY::Value *dst = get_dst(inst);
+   if (dst && is_ssa(*dst)) define(std::get<TACKY::Var>(*dst), pushed);
+  }
+
+  for (size_t succ : cfg.blocks[b].succs) {
+   if (succ == CFG::exit) continue;
+
+   std::vector<size_t> &preds = cfg.blocks[succ].preds;
+   size_t j = std::find(preds.begin(), preds.end(), b) - preds.begin();
+   for (Phi &phi : phis[succ]) use(phi.args[j]);
+  }
+ };
+
+ struct Frame {
+  size_t block, next;
+  std::vector<std::string> pushed;
+ };
+
+ std::vector<Frame> walk = {{0, 0, {}}};
+ enter(0, walk.back().pushed);
+
+ while (!walk.empty()) {
+  Frame &frame = walk.back();
+  if (frame.next < dominators.children[frame.block].size()) {
+   size_t child = dominators.children[frame.block][frame.next++];
+   walk.push_back({child, 0, {}});
+   enter(child, walk.back().pushed);
+   continue;
+  }
+
+  for (std::string &name : frame.pushed) current[name].pop_back();
+  walk.pop_back();
+ }
+}
+
+void Optimiser::SSA::reconnect() {
+ CFG &cfg = analyses.cfg();
+ std::vector<std::vector<size_t>> old_preds(cfg.blocks.size());
+ for (size_t b = 0; b < cfg.blocks.size(); b++) old_preds[b] = cfg.blocks[b].preds;
+
+ cfg.connect();
+ for (size_t b = 0; b < phis.size(); b++) {
+  std::vector<size_t> &preds = cfg.blocks[b].preds;
+
+  for (Phi &phi : phis[b]) {
+   std::vector<TACKY::Value> args;
+   for (size_t pred : preds) {
+    size_t j = std::find(old_preds[b].begin(), old_preds[b].end(), pred) - old_preds[b].begin();
+    args.push_back(phi.args[j]);
+   }
+   phi.args = std::move(args);
+  }
+ }
+}
+
+TACKY::Var Optimiser::SSA::label_of(size_t block) {
+ std::vector<TACKY::Instruction> &insts = analyses.cfg().blocks[block].insts;
+ if (!insts.empty() && std::holds_alternative<TACKY::Label>(insts[0])) return std::get<TACKY::Label>(insts[0]).name;
+
+ TACKY::Var label = analyses.label();
+ insts.insert(insts.begin(), TACKY::Label(label));
+ return label;
+}
+
+// Orders copies that all read before any writes. A copy goes once no other
+// still reads its destination; when only cycles are left, one destination
+// is saved to a new variable first.
+std::vector<TACKY::Instruction> Optimiser::SSA::sequentialise(std::vector<TACKY::Copy> copies) {
+ std::vector<TACKY::Instruction> seq;
+
+ auto reads = [](TACKY::Copy &copy, const std::string &name) {
+  TACKY::Var *src = std::get_if<TACKY::Var>(&copy.src);
+  return src && name_of(src->name) == name;
+ };
+
+ while (!copies.empty()) {
+  bool emitted = false;
+
+  for (size_t i = 0; i < copies.size() && !emitted; i++) {
+   std::string dst = name_of(std::get<TACKY::Var>(copies[i].dst).name);
+   bool read = false;
+   for (size_t j = 0; j < copies.size(); j++) read = read || (j != i && reads(copies[j], dst));
+   if (read) continue;
+
+   seq.push_back(copies[i]);
+   copies.erase(copies.begin() + i);
+   emitted = true;
+  }
+  if (emitted) continue;
+
+  TACKY::Var dst = std::get<TACKY::Var>(copies[0].dst);
+  TACKY::Var saved = analyses.temporary(dst.type);
+  seq.push_back(TACKY::Copy(dst, saved));
+  for (TACKY::Copy &copy : copies) {
+   if (reads(copy, name_of(dst.name))) copy.src = saved;
+  }
+ }
+
+ return seq;
+}
+
+// The TACKYifier ends every body with a Return, so blocks added after the
+// last one are only reached by their labels.
+void Optimiser::SSA::leave() {
+ CFG &cfg = analyses.cfg();
+ std::vector<Block> added;
+
+ for (size_t b = 0; b < phis.size(); b++) {
+  for (size_t j = 0; j < cfg.blocks[b].preds.size() && !phis[b].empty(); j++) {
+   size_t pred = cfg.blocks[b].preds[j];
+   std::vector<TACKY::Copy> copies;
+   for (Phi &phi : phis[b]) {
+    TACKY::Var *arg = std::get_if<TACKY::Var>(&phi.args[j]);
+    if (!arg || name_of(arg->name) != name_of(phi.dst.name)) copies.push_back(TACKY::Copy(phi.args[j], phi.dst));
+   }
+   if (copies.empty()) continue;
+
+   std::vector<TACKY::Instruction> seq = sequentialise(copies);
+   std::vector<TACKY::Instruction> &insts = cfg.blocks[pred].insts;
+   std::vector<size_t> &succs = cfg.blocks[pred].succs;
+
+   if (succs.size() == 1) {
+    // A branch with both sides here is a jump.
+    TACKY::Instruction *last = insts.empty() ? nullptr : &insts.back();
+    if (last && (std::holds_alternative<TACKY::JumpIfZero>(*last) || std::holds_alternative<TACKY::JumpIfNotZero>(*last))) {
+     *last = TACKY::Jump(label_of(b));
+    }
+
+    size_t at = last && std::holds_alternative<TACKY::Jump>(*last) ? insts.size() - 1 : insts.size();
+    insts.insert(insts.begin() + at, seq.begin(), seq.end());
+    continue;
+   }
+
+   // The branch's other side must not see the copies. Its first successor
+   // is the one it falls through to, and once that edge is split the branch
+   // is followed by a jump.
+   TACKY::Var label = analyses.label();
+   if (succs[0] == b) {
+    insts.push_back(TACKY::Jump(label));
+   } else {
+    TACKY::Instruction &branch = std::holds_alternative<TACKY::Jump>(insts.back()) ? insts[insts.size() - 2] : insts.back();
+    *get_target(branch) = label;
+   }
+
+   Block edge;
+   edge.insts.push_back(TACKY::Label(label));
+   edge.insts.insert(edge.insts.end(), seq.begin(), seq.end());
+   edge.insts.push_back(TACKY::Jump(label_of(b)));
+   added.push_back(std::move(edge));
+  }
+ }
+
+ for (Block &block : added) cfg.blocks.push_back(std::move(block));
+ phis.clear();
+
+ std::vector<TACKY::Instruction> body = cfg.linearise();
+ cfg = CFG(body);
+}
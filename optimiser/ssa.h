@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "pass_manager.h"
+
+namespace Optimiser {
+ struct Phi {
+  TACKY::Var dst;
+  // One value for each predecessor, in the order of the block's preds.
+  std::vector<TACKY::Value> args;
+ };
+
+ // A function's local variables in SSA form, for as long as a pass needs
+ // it. Constructing it renames every definition in the reachable blocks to
+ // a new variable, with pruned phis placed on the iterated dominance
+ // frontiers where the variable is still live; a variable read before any
+ // definition keeps its own name. Static variables are not renamed, since
+ // any call may write them.
+ //
+ // TACKY has no phi instruction, so leave() must be called before the pass
+ // returns. It turns the phis into parallel copies on the incoming edges,
+ // splitting an edge from a block that branches, and changes the CFG.
+ class SSA {
+  private:
+   FunctionAnalyses &analyses;
+
+   void place_phis();
+   void rename();
+   TACKY::Var label_of(size_t block);
+   std::vector<TACKY::Instruction> sequentialise(std::vector<TACKY::Copy> copies);
+
+  public:
+   // The phis at the start of each block.
+   std::vector<std::vector<Phi>> phis;
+
+   SSA() = delete;
+   SSA(FunctionAnalyses &analyses);
+
+   // Whether a variable has one definition, which dominates its uses.
+   bool is_ssa(TACKY::Value &val);
+   // Recomputes the edges after a pass removes some, such as by turning a
+   // branch into a jump, and drops the phi arguments of those that are
+   // gone. Edges may only be removed.
+   void reconnect();
+   void leave();
+ };
+}
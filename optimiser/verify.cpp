@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include "passes.h"
+#include "constants.h"
+#include "../tacky/util.h"
+#include "../helpers.h"
+
+// Checks what the other passes must keep true: labels are unique, every
+// jump has a target, the blocks' edges agree with each other and each
+// variable has one type. Code generation sizes a variable's stack slot from
+// its first use, so a variable used at two widths, or a copy between them,
+// reads or writes the wrong number of bytes. Changes nothing, so it can go
+// anywhere in a pipeline while debugging one.
+Optimiser::Change Optimiser::verify(FunctionAnalyses &analyses) {
+ CFG &cfg = analyses.cfg();
+ std::string func = analyses.name();
+ std::unordered_set<std::string> labels;
+ std::unordered_map<std::string, Parser::Type> types;
+
+ auto check_type = [&](TACKY::Value &val) {
+  TACKY::Var *var = std::get_if<TACKY::Var>(&val);
+  if (var == nullptr) return;
+
+  std::string name = name_of(var->name);
+  auto [it, added] = types.emplace(name, var->type);
+  if (!added && it->second != var->type) error("Variable " + name + " used with two types in " + func);
+ };
+
+ for (size_t i = 0; i < cfg.blocks.size(); i++) {
+  for (TACKY::Instruction &inst : cfg.blocks[i].insts) {
+   for_each_src(inst, check_type);
+   if (TACKY::Value *dst = get_dst(inst); dst) check_type(*dst);
+
+   std::visit(overloaded{
+    [&](auto &) {},
+    [&](TACKY::Copy &copy) {
+     if (bits(type_of(copy.src)) != bits(type_of(copy.dst))) error("Copy between types of different sizes in " + func);
+    },
+    [&](TACKY::Label &label) {
+     if (!labels.insert(name_of(label.name.name)).second) error("Duplicate label " + name_of(label.name.name) + " in " + func);
+    },
+    [&](TACKY::Jump &jump) {
+     if (!cfg.labels.count(name_of(jump.target.name))) error("Jump to a missing label in " + func);
+    },
+    [&](TACKY::JumpIfZero &jump) {
+     if (!cfg.labels.count(name_of(jump.target.name))) error("Jump to a missing label in " + func);
+    },
+    [&](TACKY::JumpIfNotZero &jump) {
+     if (!cfg.labels.count(name_of(jump.target.name))) error("Jump to a missing label in " + func);
+    }
+   }, inst);
+  }
+
+  for (size_t succ : cfg.blocks[i].succs) {
+   if (succ == CFG::exit) continue;
+
+   std::vector<size_t> &preds = cfg.blocks[succ].preds;
+   if (std::find(preds.begin(), preds.end(), i) == preds.end()) error("Inconsistent CFG edges in " + func);
+  }
+ }
+
+ return Change::None;
+}
@@ -13,7 +13,16 @@ bool is_type(TokenType type) {
 
 void CParser::parse() {
  while (token_index < lexer->tokens.size()) {
+  Trace::begin_item("Parse declaration");
   Declaration decl = parse_declaration();
+  Trace::end([&] {return std::visit([](auto &decl) {return decl.name;}, decl);});
+  FuncDecl *func = std::get_if<FuncDecl>(&decl);
+
+  // The prefix is the leading run of declarations without bodies.
+  if (prefix_decls == program.decls.size() && (func == nullptr || func->body == nullptr)) {
+   prefix_decls++;
+   prefix_tokens = token_index;
+  }
 
   program.decls.push_back(decl);
  }
@@ -99,6 +108,7 @@ Block_Item CParser::parse_block_item() {
 
 Declaration CParser::parse_declaration() {
  Declaration decl;
+ size_t token_start = token_index;
  TypeAndStorageClass tasc = parse_type_and_storage_class();
  Token name = expect(TokenType::Identifier, "Expected identifier after specifiers.");
 
@@ -106,6 +116,8 @@ Declaration CParser::parse_declaration() {
   FuncDecl func_decl = parse_function();
   func_decl.name = name;
   func_decl.ret = tasc;
+  func_decl.token_start = token_start;
+  func_decl.token_end = token_index;
 
   decl = func_decl;
  } else {
@@ -1,22 +1,60 @@
 #include <iostream>
 #include "parser.h"
 #include "../helpers.h"
+#include "../trace.h"
 #include "parse.cpp"
 #include "resolve/resolve.cpp"
+#include "snapshot.cpp"
 using namespace Parser;
 
-CParser::CParser(Lexer &lexer, bool resolve) {
+CParser::CParser(Lexer &lexer, bool resolve, DeclSnapshot *snapshot) {
  this->lexer = &lexer;
+ this->snapshot = snapshot;
  token_index = 0;
  var_count = 0;
  label_count = 0;
+ prefix_decls = prefix_tokens = 0;
+
+ if (snapshot != nullptr && snapshot->loaded) {
+  idents = snapshot->idents;
+  symbols = snapshot->symbols;
+  var_count = snapshot->var_count;
+ }
  
- parse();
+ {
+  Trace::Scope scope("Parse");
+  parse();
+ }
+
  if (resolve) {
+  // Declarations only see those before them, so the prefix can be resolved
+  // and typechecked on its own and its state captured before the rest.
+  size_t split = snapshot != nullptr && !snapshot->loaded ? prefix_decls : 0;
+
+  Trace::begin("ResolveLabels");
   resolve_labels();
-  resolve_idents();
-  typecheck();
+  Trace::end();
+
+  Trace::begin("ResolveIdents");
+  resolve_idents(0, split);
+  Trace::end();
+  Trace::begin("Typecheck");
+  typecheck(0, split);
+  Trace::end();
+  if (snapshot != nullptr && !snapshot->loaded) {
+   snapshot->capture(*this);
+  }
+
+  Trace::begin("ResolveIdents");
+  resolve_idents(split, program.decls.size());
+  Trace::end();
+  Trace::begin("Typecheck");
+  typecheck(split, program.decls.size());
+  Trace::end();
+
+  Trace::begin("LabelStatement");
   label_statement();
+  Trace::end();
  }
 }
 
@@ -8,6 +8,8 @@ bool is_signed(Parser::Type t);
 int get_type_size(Parser::Type t);
 
 namespace Parser {
+ class DeclSnapshot;
+
  struct MapEntry {
   Token name;
   bool from_current_scope;
@@ -44,6 +46,10 @@ namespace Parser {
    int token_index;
    int var_count, label_count;
    FuncDecl *curr_func;
+   DeclSnapshot *snapshot;
+   size_t prefix_decls, prefix_tokens;
+   string curr_func_name;
+   int func_static_count;
    std::unordered_map<string, MapEntry> idents;
    Program program;
  
@@ -76,7 +82,7 @@ namespace Parser {
 
    void new_scope();
    
-   void resolve_idents();
+   void resolve_idents(size_t first, size_t last);
    void resolve_idents(Block &item);
    void resolve_idents(Block_Item &item);
    void resolve_idents(Declaration &decl, bool in_block = true);
@@ -92,7 +98,7 @@ namespace Parser {
    void label_statement(Statement &stmt, Token current_label, Switch *curr_swtch = nullptr, bool in_switch = false);
    void label_statement(Statement *stmt, Token current_label, Switch *curr_swtch = nullptr, bool in_switch = false);
    
-   void typecheck();
+   void typecheck(size_t first, size_t last);
    void typecheck(Block &block);
    void typecheck(Block_Item &item);
    void typecheck(Declaration &decl);
@@ -105,9 +111,11 @@ namespace Parser {
    void typecheck(Expression *expr);
 
   public:
+   friend class DeclSnapshot;
+
    SymbolTable symbols;
    CParser() = delete;
-   CParser(Lexer &lexer, bool resolve);
+   CParser(Lexer &lexer, bool resolve, DeclSnapshot *snapshot = nullptr);
  
    Program get_program();
    int get_var_count();
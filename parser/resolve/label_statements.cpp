@@ -11,6 +11,7 @@ void CParser::label_statement() {
   FuncDecl *func = std::get_if<FuncDecl>(&decl);
   if (func == nullptr || func->body == nullptr) continue;
   
+  Trace::Scope scope("Label statements", [&] {return func->name;});
   label_statement(*func->body, null_token);
  }
 }
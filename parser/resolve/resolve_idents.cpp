@@ -3,9 +3,10 @@
 #include "../../helpers.h"
 using namespace Parser;
 
-void CParser::resolve_idents() {
- for (Declaration &decl : program.decls) {
-  resolve_idents(decl, false);
+void CParser::resolve_idents(size_t first, size_t last) {
+ for (size_t i = first; i < last; i++) {
+  Trace::Scope scope("Resolve declaration", [&] {return std::visit([](auto &decl) {return decl.name;}, program.decls[i]);});
+  resolve_idents(program.decls[i], false);
  }
 }
 
@@ -73,6 +74,8 @@ void CParser::resolve_idents(FuncDecl &decl, bool in_block) {
  }
 
  if (decl.body != nullptr) {
+  curr_func_name = func_name;
+  func_static_count = 0;
   resolve_idents(*decl.body);
  }
 
@@ -103,7 +106,14 @@ void CParser::resolve_idents(VarDecl &decl, bool in_block) {
     .has_linkage = true
    };
   } else {
-   MapEntry new_var = make_var(var_name);
+   MapEntry new_var;
+   if (decl.tasc.storage_class == StorageClass::Static) {
+    // Named after the enclosing function and numbered within it, so the
+    // symbol stays the same when other functions change.
+    new_var = make_var(curr_func_name + "." + var_name + "." + std::to_string(func_static_count++), true);
+    new_var.has_linkage = false;
+   } else new_var = make_var(var_name);
+
    idents[var_name] = new_var;
    decl.name = new_var.name;
    resolve_idents(decl.init);
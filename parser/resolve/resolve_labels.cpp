@@ -8,6 +8,7 @@ void CParser::resolve_labels() {
   FuncDecl *func = std::get_if<FuncDecl>(&decl);
   if (func == nullptr || func->body == nullptr) continue;
 
+  Trace::Scope scope("Resolve labels", [&] {return func->name;});
   curr_func = func;
   resolve_labels(*func->body);
  }
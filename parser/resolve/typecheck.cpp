@@ -3,8 +3,9 @@
 #include "../../helpers.h"
 using namespace Parser;
 
-void CParser::typecheck() {
- for (Declaration &decl : program.decls) {
+void CParser::typecheck(size_t first, size_t last) {
+ for (size_t i = first; i < last; i++) {
+   Trace::Scope scope("Typecheck declaration", [&] {return std::visit([](auto &decl) {return decl.name;}, program.decls[i]);});
    std::visit(overloaded{
     [&](VarDecl &var) {
      typecheck_file_scope(var);
@@ -13,7 +14,7 @@ void CParser::typecheck() {
      curr_func = &func;
      typecheck(func);
     }
-   }, decl);
+   }, program.decls[i]);
  }
 }
 
@@ -221,6 +222,18 @@ int get_type_size(Type t) {
  }
 }
 
+static bool is_comparison(BinaryOp op) {
+ switch (op) {
+  case BinaryOp::Equal:
+  case BinaryOp::Not_Equal:
+  case BinaryOp::Less_Than:
+  case BinaryOp::Less_Or_Equal:
+  case BinaryOp::Greater_Than:
+  case BinaryOp::Greater_Or_Equal: return true;
+  default: return false;
+ }
+}
+
 Type get_common_type(Type t1, Type t2) {
  if (t1 == t2) return t1;
  if (get_type_size(t1) == get_type_size(t2)) {
@@ -365,7 +378,7 @@ class TypecheckingExpressionVisitor : public ExpressionVisitor {
     convert_to(bin->left, common_type);
     convert_to(bin->right, common_type);
 
-    bin->type = common_type;
+    bin->type = is_comparison(bin->op) ? Type::Int : common_type;
    }
   }
   
@@ -391,6 +404,8 @@ class TypecheckingExpressionVisitor : public ExpressionVisitor {
    cond->right->accept(this);
 
    cond->type = get_common_type(cond->left->type, cond->right->type);
+   convert_to(cond->left, cond->type);
+   convert_to(cond->right, cond->type);
   }
   
   void visit(Cast *cast) {
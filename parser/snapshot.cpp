@@ -0,0 +1,175 @@
+#pragma once
+#include <cstring>
+#include <sys/mman.h>
+#include "snapshot.h"
+#include "../cache.h"
+using namespace Parser;
+
+static const char snapshot_magic[4] = {'C', 'D', 'S', 'N'};
+static const uint32_t snapshot_version = 1;
+
+void DeclSnapshot::capture(CParser &parser) {
+ idents = parser.idents;
+ symbols = parser.symbols;
+ var_count = parser.var_count;
+ prefix_bytes = parser.lexer->offset(parser.prefix_tokens);
+}
+
+static string prefix_hash(const string &src, size_t length) {
+ return Hasher().add(file_fingerprint("/proc/self/exe")).add(src.data(), length).hex();
+}
+
+// Layout: magic, version, prefix hash, prefix length and line, var_count and
+// the entry counts, then the idents and symbols with length-prefixed strings.
+bool DeclSnapshot::save(string path, const string &src) {
+ string out;
+ auto put = [&](uint64_t num, size_t size) {out.append((const char *)&num, size);};
+ auto put_str = [&](const string &str) {put(str.size(), 4); out += str;};
+
+ int line = 1;
+ for (size_t i = 0; i < prefix_bytes; i++) line += src[i] == '\n';
+
+ out.append(snapshot_magic, 4);
+ put(snapshot_version, 4);
+ out += prefix_hash(src, prefix_bytes);
+ put(prefix_bytes, 8);
+ put(line, 4);
+ put(var_count, 4);
+ put(idents.size(), 4);
+ put(symbols.size(), 4);
+
+ for (auto &[key, entry] : idents) {
+  put_str(key);
+  put_str(string(entry.name.start, entry.name.length));
+  put(entry.name.line, 4);
+  put(entry.from_current_scope | entry.has_linkage << 1, 1);
+ }
+
+ for (auto &[key, entry] : symbols) {
+  put_str(key);
+  put((uint64_t)entry.type, 1);
+  put((uint64_t)entry.ret_type, 1);
+  put((uint64_t)entry.attr_type, 1);
+  put((uint64_t)entry.init_val_type, 1);
+  put(entry.global | entry.defined << 1, 1);
+  put_str(entry.init_val);
+  put(entry.param_types.size(), 4);
+  for (Type type : entry.param_types) put((uint64_t)type, 1);
+ }
+
+ string tmp_path = path + ".XXXXXX";
+ int fd = mkstemp(tmp_path.data());
+ if (fd < 0) return false;
+
+ bool ok = fchmod(fd, 0644) == 0;
+ for (size_t written = 0; ok && written < out.size();) {
+  ssize_t n = write(fd, out.data() + written, out.size() - written);
+  ok = n > 0;
+  written += ok ? n : 0;
+ }
+
+ ok = close(fd) == 0 && ok;
+ ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+ if (!ok) unlink(tmp_path.c_str());
+
+ return ok;
+}
+
+// The file stays mapped for the rest of the compile: restored idents point
+// straight into it.
+bool DeclSnapshot::load(string path, const string &src) {
+ int fd = open(path.c_str(), O_RDONLY);
+ if (fd < 0) return false;
+
+ struct stat st;
+ void *map = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+ close(fd);
+ if (map == MAP_FAILED) return false;
+
+ const char *curr = (const char *)map, *end = curr + st.st_size;
+ bool ok = true;
+ auto get = [&](size_t size) -> uint64_t {
+  uint64_t num = 0;
+  ok = ok && (size_t)(end - curr) >= size;
+  if (ok) memcpy(&num, curr, size);
+  curr += ok ? size : 0;
+  return num;
+ };
+ auto get_str = [&](size_t length) -> const char * {
+  const char *str = curr;
+  ok = ok && (size_t)(end - curr) >= length;
+  curr += ok ? length : 0;
+  return str;
+ };
+
+ ok = memcmp(get_str(4), snapshot_magic, 4) == 0 && get(4) == snapshot_version;
+ const char *hash = get_str(32);
+ size_t length = get(8);
+ int line = get(4);
+ int count = get(4);
+ size_t num_idents = get(4), num_symbols = get(4);
+
+ if (!ok || length > src.size() || string(hash, 32) != prefix_hash(src, length)) {
+  munmap(map, st.st_size);
+  return false;
+ }
+
+ std::unordered_map<string, MapEntry> new_idents;
+ SymbolTable new_symbols;
+
+ for (size_t i = 0; ok && i < num_idents; i++) {
+  size_t key_length = get(4);
+  const char *key = get_str(key_length);
+  size_t name_length = get(4);
+  char *name = (char *)get_str(name_length);
+  size_t name_line = get(4);
+  int flags = get(1);
+
+  if (!ok) break;
+  new_idents[string(key, key_length)] = {
+   .name = {.type = TokenType::Identifier, .start = name, .length = name_length, .line = name_line},
+   .from_current_scope = (flags & 1) != 0,
+   .has_linkage = (flags & 2) != 0
+  };
+ }
+
+ for (size_t i = 0; ok && i < num_symbols; i++) {
+  size_t key_length = get(4);
+  const char *key = get_str(key_length);
+  TypeEntry entry;
+
+  entry.type = (Type)get(1);
+  entry.ret_type = (Type)get(1);
+  entry.attr_type = (AttrType)get(1);
+  entry.init_val_type = (InitValType)get(1);
+  int flags = get(1);
+  entry.global = (flags & 1) != 0;
+  entry.defined = (flags & 2) != 0;
+
+  size_t init_length = get(4);
+  const char *init_val = get_str(init_length);
+
+  size_t num_params = get(4);
+  for (size_t p = 0; ok && p < num_params; p++) {
+   entry.param_types.push_back((Type)get(1));
+  }
+
+  if (!ok) break;
+  entry.init_val = string(init_val, init_length);
+  new_symbols[string(key, key_length)] = entry;
+ }
+
+ if (!ok) {
+  munmap(map, st.st_size);
+  return false;
+ }
+
+ idents = std::move(new_idents);
+ symbols = std::move(new_symbols);
+ var_count = count;
+ prefix_bytes = length;
+ prefix_line = line;
+ loaded = true;
+
+ return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "parser.h"
+
+namespace Parser {
+ // Front-end state after the leading run of declarations without bodies,
+ // which is what shared headers expand to. A compile whose source starts with
+ // the same bytes restores it and only lexes and parses the rest.
+ class DeclSnapshot {
+  public:
+   bool loaded = false;
+   size_t prefix_bytes = 0;
+   int prefix_line = 1;
+   int var_count = 0;
+   std::unordered_map<string, MapEntry> idents;
+   SymbolTable symbols;
+
+   void capture(CParser &parser);
+   bool load(string path, const string &src);
+   bool save(string path, const string &src);
+ };
+}
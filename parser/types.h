@@ -24,6 +24,7 @@ namespace Parser {
   std::vector<Type> param_types;
   std::vector<Token> params;
   Block *body;
+  size_t token_start, token_end;
  };
 
  using Declaration = std::variant<VarDecl, FuncDecl>;
@@ -0,0 +1,165 @@
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_counters.h"
+#include "trace.h"
+
+enum Counter {
+ Cycles,
+ Instructions,
+ L1DMisses,
+ LLCMisses,
+ BranchMisses,
+ NumCounters
+};
+
+struct PhaseCounts {
+ const char *name;
+ size_t depth;
+ double ms;
+ // -1 where the counter could not be opened.
+ int64_t counts[NumCounters];
+};
+
+static int open_counter(uint32_t type, uint64_t config) {
+ perf_event_attr attr;
+ memset(&attr, 0, sizeof(attr));
+ attr.size = sizeof(attr);
+ attr.type = type;
+ attr.config = config;
+ attr.exclude_kernel = 1;
+ attr.exclude_hv = 1;
+ attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+ return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// The counters are opened separately rather than as a group, so that one
+// the CPU lacks does not take the others with it; when the kernel has to
+// multiplex them the counts are scaled by the time each one ran.
+class CounterObserver : public Trace::Observer {
+ private:
+  struct Open {
+   size_t index;
+   std::chrono::steady_clock::time_point start;
+   int64_t counts[NumCounters];
+  };
+
+  int fds[NumCounters];
+  std::vector<Open> open;
+
+  int64_t read_counter(int counter) {
+   uint64_t values[3];
+   if (fds[counter] == -1 || read(fds[counter], values, sizeof(values)) != sizeof(values)) return -1;
+   if (values[2] == 0) return 0;
+
+   return (int64_t)((double)values[0] * values[1] / values[2]);
+  }
+
+ public:
+  std::vector<PhaseCounts> phases;
+  bool available;
+
+  CounterObserver() : available(false) {
+   for (int &fd : fds) fd = -1;
+  }
+
+  void open_counters() {
+   auto cache_miss = [](uint64_t cache) {
+    return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+   };
+
+   fds[Cycles] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+   fds[Instructions] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+   fds[L1DMisses] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D));
+   fds[LLCMisses] = open_counter(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+   fds[BranchMisses] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+   available = fds[Cycles] != -1 && fds[Instructions] != -1;
+  }
+
+  void phase_begin(const char *name) override {
+   open.push_back({phases.size(), {}, {}});
+   phases.push_back({name, open.size() - 1, 0, {}});
+
+   Open &phase = open.back();
+   for (int i = 0; i < NumCounters; i++) phase.counts[i] = read_counter(i);
+   phase.start = std::chrono::steady_clock::now();
+  }
+
+  void phase_end(const char *) override {
+   if (open.empty()) return;
+
+   auto end = std::chrono::steady_clock::now();
+   Open &phase = open.back();
+   PhaseCounts &counts = phases[phase.index];
+   for (int i = 0; i < NumCounters; i++) {
+    int64_t value = read_counter(i);
+    counts.counts[i] = value == -1 || phase.counts[i] == -1 ? -1 : value - phase.counts[i];
+   }
+
+   counts.ms = std::chrono::duration<double, std::milli>(end - phase.start).count();
+   open.pop_back();
+  }
+};
+
+static CounterObserver observer;
+
+static void print_counters() {
+ if (!observer.available) {
+  fprintf(stderr, "perf_event_open is unavailable (see /proc/sys/kernel/perf_event_paranoid); wall time only\n");
+  fprintf(stderr, "%-28s %10s\n", "Phase", "ms");
+  for (PhaseCounts &phase : observer.phases) {
+   std::string name = std::string(phase.depth * 2, ' ') + phase.name;
+   fprintf(stderr, "%-28s %10.3f\n", name.c_str(), phase.ms);
+  }
+
+  return;
+ }
+
+ fprintf(
+  stderr, "%-28s %10s %14s %14s %6s %9s %9s %9s\n",
+  "Phase", "ms", "cycles", "instructions", "IPC", "L1D MPKI", "LLC MPKI", "br MPKI"
+ );
+
+ for (PhaseCounts &phase : observer.phases) {
+  std::string name = std::string(phase.depth * 2, ' ') + phase.name;
+  int64_t *counts = phase.counts;
+  double kilo_insts = counts[Instructions] / 1000.0;
+
+  auto mpki = [&](Counter counter) {
+   char buf[16];
+   if (counts[counter] == -1 || kilo_insts <= 0) return std::string("-");
+   snprintf(buf, sizeof(buf), "%.2f", counts[counter] / kilo_insts);
+   return std::string(buf);
+  };
+
+  fprintf(
+   stderr, "%-28s %10.3f %14lld %14lld %6.2f %9s %9s %9s\n",
+   name.c_str(),
+   phase.ms,
+   (long long)counts[Cycles],
+   (long long)counts[Instructions],
+   counts[Cycles] > 0 ? (double)counts[Instructions] / counts[Cycles] : 0.0,
+   mpki(L1DMisses).c_str(),
+   mpki(LLCMisses).c_str(),
+   mpki(BranchMisses).c_str()
+  );
+ }
+}
+
+void PerfCounters::start() {
+ static bool started = false;
+ if (started) return;
+
+ started = true;
+ observer.open_counters();
+ Trace::observe(&observer);
+ atexit(print_counters);
+}
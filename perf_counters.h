@@ -0,0 +1,9 @@
+#pragma once
+
+// --perf-counters: hardware counters (cycles, instructions, L1D, LLC and
+// branch misses) read around each Trace phase through perf_event_open, and
+// printed on stderr at exit with IPC and misses per thousand instructions.
+// Where the kernel refuses the counters only wall time is reported.
+namespace PerfCounters {
+ void start();
+}
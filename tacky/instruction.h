@@ -89,6 +89,7 @@ namespace TACKY {
  struct FunCall {
   Token name;
   std::vector<Value> args;
+  // A Constant once the optimiser finds the result unused.
   Value dst;
 
   FunCall(Token name) : name(name) {}
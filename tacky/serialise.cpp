@@ -0,0 +1,347 @@
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "serialise.h"
+#include "../helpers.h"
+using namespace TACKY;
+
+// Layout: header, string table, symbols, statics, functions. Every name is an
+// (offset, length) pair into the string table and every value takes 10
+// bytes, so a function body is read into a single reserved vector.
+static const char tacky_magic[4] = {'T', 'C', 'K', 'Y'};
+static const uint32_t tacky_version = 1;
+
+namespace {
+ enum ValueKind : uint8_t {
+  Const,
+  Variable,
+ };
+
+ class Writer {
+  private:
+   std::unordered_map<string, uint32_t> offsets;
+
+  public:
+   string strings, out;
+
+   void put(uint64_t num, size_t size) {
+    out.append((const char *)&num, size);
+   }
+
+   void put_name(const char *start, size_t length) {
+    string name(start, length);
+    auto it = offsets.find(name);
+    if (it == offsets.end()) {
+     it = offsets.emplace(name, strings.size()).first;
+     strings += name;
+    }
+
+    put(it->second, 4);
+    put(length, 4);
+   }
+
+   void put_name(Token &token) {put_name(token.start, token.length);}
+   void put_name(const string &str) {put_name(str.data(), str.size());}
+
+   void put_value(TACKY::Value &value) {
+    std::visit(overloaded{
+     [&](TACKY::Constant &_const) {
+      put(ValueKind::Const, 1);
+      put((uint64_t)_const.type, 1);
+      put(_const._const, 8);
+     },
+     [&](TACKY::Var &var) {
+      put(ValueKind::Variable, 1);
+      put((uint64_t)var.type, 1);
+      put_name(var.name);
+     }
+    }, value);
+   }
+
+   void put_instruction(TACKY::Instruction &inst) {
+    put(inst.index(), 1);
+    std::visit(overloaded{
+     [&](TACKY::Unary &unary) {
+      put(unary.op, 1);
+      put_value(unary.src);
+      put_value(unary.dst);
+     },
+     [&](TACKY::Return &ret) {
+      put_value(ret.val);
+     },
+     [&](TACKY::Binary &binary) {
+      put(binary.op, 1);
+      put_value(binary.src1);
+      put_value(binary.src2);
+      put_value(binary.dst);
+     },
+     [&](TACKY::Copy &copy)             {put_value(copy.src); put_value(copy.dst);},
+     [&](TACKY::SignExtend &extend)     {put_value(extend.src); put_value(extend.dst);},
+     [&](TACKY::ZeroExtend &extend)     {put_value(extend.src); put_value(extend.dst);},
+     [&](TACKY::Truncate &truncate)     {put_value(truncate.src); put_value(truncate.dst);},
+     [&](TACKY::Jump &jump)             {put_name(jump.target.name);},
+     [&](TACKY::JumpIfZero &jump)       {put_value(jump.val); put_name(jump.target.name);},
+     [&](TACKY::JumpIfNotZero &jump)    {put_value(jump.val); put_name(jump.target.name);},
+     [&](TACKY::Label &label)           {put_name(label.name.name);},
+     [&](TACKY::FunCall &call) {
+      put_name(call.name);
+      put(call.args.size(), 4);
+      for (TACKY::Value &arg : call.args) put_value(arg);
+      put_value(call.dst);
+     }
+    }, inst);
+   }
+ };
+
+ class Reader {
+  private:
+   const char *curr, *end, *strings;
+   size_t strings_size;
+
+  public:
+   bool ok = true;
+
+   Reader(const char *data, size_t size) : curr(data), end(data + size), strings(nullptr), strings_size(0) {}
+
+   uint64_t get(size_t size) {
+    uint64_t num = 0;
+    ok = ok && (size_t)(end - curr) >= size;
+    if (ok) memcpy(&num, curr, size);
+    curr += ok ? size : 0;
+    return num;
+   }
+
+   const char *get_bytes(size_t length) {
+    const char *bytes = curr;
+    ok = ok && (size_t)(end - curr) >= length;
+    curr += ok ? length : 0;
+    return bytes;
+   }
+
+   void set_strings(size_t size) {
+    strings_size = size;
+    strings = get_bytes(size);
+   }
+
+   Token get_name() {
+    size_t offset = get(4), length = get(4);
+    ok = ok && offset + length <= strings_size;
+
+    return {.type = TokenType::Identifier, .start = (char *)(ok ? strings + offset : strings), .length = ok ? length : 0, .line = 0};
+   }
+
+   TACKY::Var get_label() {
+    return TACKY::Var(get_name());
+   }
+
+   TACKY::Value get_value() {
+    uint8_t kind = get(1);
+    Parser::Type type = (Parser::Type)get(1);
+
+    if (kind == ValueKind::Const) {
+     TACKY::Constant _const(get(8));
+     _const.type = type;
+     return _const;
+    }
+
+    TACKY::Var var(get_name());
+    var.type = type;
+    return var;
+   }
+
+   TACKY::Instruction get_instruction() {
+    switch (get(1)) {
+     case 0: {
+      Parser::UnaryOp op = (Parser::UnaryOp)get(1);
+      TACKY::Value src = get_value();
+      TACKY::Unary unary(src, get_value());
+      unary.op = op;
+      return unary;
+     }
+     case 1: return TACKY::Return(get_value());
+     case 2: {
+      Parser::BinaryOp op = (Parser::BinaryOp)get(1);
+      TACKY::Value src1 = get_value(), src2 = get_value();
+      TACKY::Binary binary(src1, src2, get_value());
+      binary.op = op;
+      return binary;
+     }
+     case 3:  {TACKY::Value src = get_value(); return TACKY::Copy(src, get_value());}
+     case 4:  {TACKY::Value src = get_value(); return TACKY::SignExtend(src, get_value());}
+     case 5:  {TACKY::Value src = get_value(); return TACKY::ZeroExtend(src, get_value());}
+     case 6:  {TACKY::Value src = get_value(); return TACKY::Truncate(src, get_value());}
+     case 7:  return TACKY::Jump(get_label());
+     case 8:  {TACKY::Value val = get_value(); return TACKY::JumpIfZero(val, get_label());}
+     case 9:  {TACKY::Value val = get_value(); return TACKY::JumpIfNotZero(val, get_label());}
+     case 10: return TACKY::Label(get_label());
+     case 11: {
+      TACKY::FunCall call(get_name());
+      size_t num_args = get(4);
+      for (size_t i = 0; ok && i < num_args; i++) {
+       call.args.push_back(get_value());
+      }
+      call.dst = get_value();
+      return call;
+     }
+    }
+
+    ok = false;
+    return TACKY::Return();
+   }
+ };
+}
+
+string TACKY::serialise(TACKY::Program &program, Parser::SymbolTable &symbols) {
+ Writer writer;
+
+ writer.put(symbols.size(), 4);
+ for (auto &[name, entry] : symbols) {
+  writer.put_name(name);
+  writer.put((uint64_t)entry.type, 1);
+  writer.put((uint64_t)entry.ret_type, 1);
+  writer.put((uint64_t)entry.attr_type, 1);
+  writer.put((uint64_t)entry.init_val_type, 1);
+  writer.put(entry.global | entry.defined << 1, 1);
+  writer.put_name(entry.init_val);
+  writer.put(entry.param_types.size(), 4);
+  for (Parser::Type type : entry.param_types) writer.put((uint64_t)type, 1);
+ }
+
+ writer.put(program.statics.size(), 4);
+ for (TACKY::StaticVariable &var : program.statics) {
+  writer.put_name(var.name);
+  writer.put((uint64_t)var.type, 1);
+  writer.put((uint64_t)var.init_val_type, 1);
+  writer.put(var.global, 1);
+  writer.put(var.init, 8);
+ }
+
+ writer.put(program.funcs.size(), 4);
+ for (TACKY::Function &func : program.funcs) {
+  writer.put_name(func.name);
+  writer.put(func.global, 1);
+  writer.put(func.params.size(), 4);
+  for (TACKY::Var &param : func.params) {
+   TACKY::Value value = param;
+   writer.put_value(value);
+  }
+
+  writer.put(func.body.size(), 4);
+  for (TACKY::Instruction &inst : func.body) {
+   writer.put_instruction(inst);
+  }
+ }
+
+ string header(tacky_magic, 4);
+ Writer lengths;
+ lengths.put(tacky_version, 4);
+ lengths.put(writer.strings.size(), 4);
+
+ return header + lengths.out + writer.strings + writer.out;
+}
+
+bool TACKY::deserialise(const char *data, size_t size, TACKY::Program &program, Parser::SymbolTable &symbols) {
+ Reader reader(data, size);
+
+ if (memcmp(reader.get_bytes(4), tacky_magic, 4) != 0 || reader.get(4) != tacky_version) {
+  return false;
+ }
+ reader.set_strings(reader.get(4));
+
+ size_t num_symbols = reader.get(4);
+ for (size_t i = 0; reader.ok && i < num_symbols; i++) {
+  Token name = reader.get_name();
+  Parser::TypeEntry entry;
+
+  entry.type = (Parser::Type)reader.get(1);
+  entry.ret_type = (Parser::Type)reader.get(1);
+  entry.attr_type = (Parser::AttrType)reader.get(1);
+  entry.init_val_type = (Parser::InitValType)reader.get(1);
+  int flags = reader.get(1);
+  entry.global = (flags & 1) != 0;
+  entry.defined = (flags & 2) != 0;
+
+  Token init_val = reader.get_name();
+  entry.init_val = string(init_val.start, init_val.length);
+
+  size_t num_params = reader.get(4);
+  for (size_t p = 0; reader.ok && p < num_params; p++) {
+   entry.param_types.push_back((Parser::Type)reader.get(1));
+  }
+
+  symbols[string(name.start, name.length)] = entry;
+ }
+
+ size_t num_statics = reader.get(4);
+ program.statics.reserve(reader.ok ? num_statics : 0);
+ for (size_t i = 0; reader.ok && i < num_statics; i++) {
+  TACKY::StaticVariable var;
+  var.name = reader.get_name();
+  var.type = (Parser::Type)reader.get(1);
+  var.init_val_type = (Parser::InitValType)reader.get(1);
+  var.global = reader.get(1) != 0;
+  var.init = reader.get(8);
+
+  program.statics.push_back(var);
+ }
+
+ size_t num_funcs = reader.get(4);
+ program.funcs.reserve(reader.ok ? num_funcs : 0);
+ for (size_t i = 0; reader.ok && i < num_funcs; i++) {
+  TACKY::Function func;
+  func.name = reader.get_name();
+  func.global = reader.get(1) != 0;
+
+  size_t num_params = reader.get(4);
+  for (size_t p = 0; reader.ok && p < num_params; p++) {
+   TACKY::Value param = reader.get_value();
+   if (TACKY::Var *var = std::get_if<TACKY::Var>(&param); var) func.params.push_back(*var);
+  }
+
+  size_t num_insts = reader.get(4);
+  // Every instruction takes at least one byte, which bounds the reservation.
+  func.body.reserve(std::min(num_insts, size));
+  for (size_t n = 0; reader.ok && n < num_insts; n++) {
+   func.body.push_back(reader.get_instruction());
+  }
+
+  program.funcs.push_back(std::move(func));
+ }
+
+ return reader.ok;
+}
+
+bool TACKY::save(string path, TACKY::Program &program, Parser::SymbolTable &symbols) {
+ string data = serialise(program, symbols);
+ string tmp_path = path + ".XXXXXX";
+ int fd = mkstemp(tmp_path.data());
+ if (fd < 0) return false;
+
+ bool ok = fchmod(fd, 0644) == 0;
+ for (size_t written = 0; ok && written < data.size();) {
+  ssize_t n = write(fd, data.data() + written, data.size() - written);
+  ok = n > 0;
+  written += ok ? n : 0;
+ }
+
+ ok = close(fd) == 0 && ok;
+ ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+ if (!ok) unlink(tmp_path.c_str());
+
+ return ok;
+}
+
+bool TACKY::load(string path, TACKY::Program &program, Parser::SymbolTable &symbols) {
+ int fd = open(path.c_str(), O_RDONLY);
+ if (fd < 0) return false;
+
+ struct stat st;
+ void *map = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+ close(fd);
+ if (map == MAP_FAILED) return false;
+
+ return deserialise((const char *)map, st.st_size, program, symbols);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include "types.h"
+#include "../parser/parser.h"
+
+// A compact binary form of a TACKY program and the symbol table the backend
+// needs, so lowering can be cached or run separately from the front end.
+// Names live in a single string table that loaded Tokens point into.
+namespace TACKY {
+ std::string serialise(Program &program, Parser::SymbolTable &symbols);
+ bool deserialise(const char *data, size_t size, Program &program, Parser::SymbolTable &symbols);
+
+ bool save(std::string path, Program &program, Parser::SymbolTable &symbols);
+ // The file is memory-mapped and stays mapped for the rest of the process.
+ bool load(std::string path, Program &program, Parser::SymbolTable &symbols);
+}
@@ -1,9 +1,11 @@
 #include "tacky.h"
 #include "../helpers.h"
+#include "../trace.h"
 using namespace TACKY;
 
-TACKYifier::TACKYifier(Parser::CParser &parser) {
+TACKYifier::TACKYifier(Parser::CParser &parser, std::unordered_set<string> skip) {
  this->parser = &parser;
+ this->skip = skip;
  this->symbols = &parser.symbols;
  this->temp_var_count = parser.get_var_count();
  this->label_count = 0;
@@ -92,7 +94,8 @@ void TACKYifier::tackyify() {
 
 
 void TACKYifier::tackyify(Parser::FuncDecl function) {
- if (function.body == nullptr) return;
+ if (function.body == nullptr || skip.count(function.name.to_string())) return;
+ Trace::Scope scope("TACKYify function", [&] {return function.name;});
  
  Function func;
  func.name = function.name;
@@ -189,7 +192,7 @@ void TACKYifier::tackyify(Parser::Statement *stmt) {
    string loop_name = while_stmt.label.to_string();
    Var continue_label = make_label("continue_", loop_name);
    Var break_label = make_label("break_", loop_name);
-   Var cond_var = make_tacky_var();
+   Var cond_var = make_tacky_var(while_stmt.condition->type);
    
    function_body.push_back(TACKY::Label(continue_label));
    Value cond_res = tackyify(while_stmt.condition);
@@ -204,7 +207,7 @@ void TACKYifier::tackyify(Parser::Statement *stmt) {
    Var start_label = make_label();
    Var continue_label = make_label("continue_", loop_name);
    Var break_label = make_label("break_", loop_name);
-   Var cond_var = make_tacky_var();
+   Var cond_var = make_tacky_var(do_while_stmt.condition->type);
 
    function_body.push_back(TACKY::Label(start_label));
    tackyify(do_while_stmt.body);
@@ -227,7 +230,7 @@ void TACKYifier::tackyify(Parser::Statement *stmt) {
 
    Value cond_res = tackyify(for_stmt.condition);
    if (Constant *konst = std::get_if<Constant>(&cond_res); konst == nullptr || konst->_const == 0) {
-    Var cond_var = make_tacky_var();
+    Var cond_var = make_tacky_var(for_stmt.condition->type);
     function_body.push_back(Copy(cond_res, cond_var));
     function_body.push_back(JumpIfZero(cond_var, break_label));
    }
@@ -376,8 +379,8 @@ class TackyifyingExpressionVisitor : public Parser::ExpressionVisitor {
     function_body.push_back(inst);
     val = inst.dst;
    } else {
-    Var v1 = tackyifier.make_tacky_var(expr->type);
-    Var v2 = tackyifier.make_tacky_var(expr->type);
+    Var v1 = tackyifier.make_tacky_var(expr->left->type);
+    Var v2 = tackyifier.make_tacky_var(expr->right->type);
     Var result = tackyifier.make_tacky_var(expr->type);
     Var end = tackyifier.make_label();
     Value e1, e2;
@@ -449,7 +452,7 @@ class TackyifyingExpressionVisitor : public Parser::ExpressionVisitor {
   
   void visit(Parser::Conditional *expr) {
    Value cond_res = tackyifier.tackyify(expr->condition);
-   Var cond_var = tackyifier.make_tacky_var(expr->type);
+   Var cond_var = tackyifier.make_tacky_var(expr->condition->type);
    Var result = tackyifier.make_tacky_var(expr->type);
    Var else_label = tackyifier.make_label();
    Var end_label = tackyifier.make_label();
@@ -27,8 +27,9 @@ class TACKYifier {
   Value tackyify(Parser::Expression *expr);
 
   Parser::SymbolTable *symbols;
+  std::unordered_set<string> skip;
   TACKYifier() = delete;
-  TACKYifier(Parser::CParser &parser);
+  TACKYifier(Parser::CParser &parser, std::unordered_set<string> skip = {});
 
   TACKY::Program get_program();
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <cstdio>
+#include "types.h"
+#include "../helpers.h"
+
+// Helpers for passes that rewrite TACKY.
+
+// A new identifier; like the TACKYifier's names it is never freed.
+inline Token make_name(const std::string &name) {
+ Token tmp = {.type = TokenType::Identifier, .start = new char[name.size() + 1], .line = 0};
+ tmp.length = (size_t)sprintf(tmp.start, "%s", name.c_str());
+
+ return tmp;
+}
+
+inline std::string name_of(Token &token) {
+ return std::string(token.start, token.length);
+}
+
+// Calls f on every name an instruction mentions: variables, labels and callees.
+template<class F>
+void for_each_name(TACKY::Instruction &inst, F f) {
+ auto value = [&](TACKY::Value &val) {
+  if (TACKY::Var *var = std::get_if<TACKY::Var>(&val); var) f(var->name);
+ };
+
+ std::visit(overloaded{
+  [&](TACKY::Unary &unary)          {value(unary.src); value(unary.dst);},
+  [&](TACKY::Return &ret)           {value(ret.val);},
+  [&](TACKY::Binary &binary)        {value(binary.src1); value(binary.src2); value(binary.dst);},
+  [&](TACKY::Copy &copy)            {value(copy.src); value(copy.dst);},
+  [&](TACKY::SignExtend &extend)    {value(extend.src); value(extend.dst);},
+  [&](TACKY::ZeroExtend &extend)    {value(extend.src); value(extend.dst);},
+  [&](TACKY::Truncate &truncate)    {value(truncate.src); value(truncate.dst);},
+  [&](TACKY::Jump &jump)            {f(jump.target.name);},
+  [&](TACKY::JumpIfZero &jump)      {value(jump.val); f(jump.target.name);},
+  [&](TACKY::JumpIfNotZero &jump)   {value(jump.val); f(jump.target.name);},
+  [&](TACKY::Label &label)          {f(label.name.name);},
+  [&](TACKY::FunCall &call) {
+   f(call.name);
+   for (TACKY::Value &arg : call.args) value(arg);
+   value(call.dst);
+  }
+ }, inst);
+}
+
+// Calls f on every value an instruction reads.
+template<class F>
+void for_each_src(TACKY::Instruction &inst, F f) {
+ std::visit(overloaded{
+  [&](auto &) {},
+  [&](TACKY::Unary &unary)          {f(unary.src);},
+  [&](TACKY::Return &ret)           {f(ret.val);},
+  [&](TACKY::Binary &binary)        {f(binary.src1); f(binary.src2);},
+  [&](TACKY::Copy &copy)            {f(copy.src);},
+  [&](TACKY::SignExtend &extend)    {f(extend.src);},
+  [&](TACKY::ZeroExtend &extend)    {f(extend.src);},
+  [&](TACKY::Truncate &truncate)    {f(truncate.src);},
+  [&](TACKY::JumpIfZero &jump)      {f(jump.val);},
+  [&](TACKY::JumpIfNotZero &jump)   {f(jump.val);},
+  [&](TACKY::FunCall &call) {
+   for (TACKY::Value &arg : call.args) f(arg);
+  }
+ }, inst);
+}
+
+inline TACKY::Value *get_dst(TACKY::Instruction &inst) {
+ return std::visit(overloaded{
+  [](auto &) -> TACKY::Value * {return nullptr;},
+  [](TACKY::Unary &unary)       -> TACKY::Value * {return &unary.dst;},
+  [](TACKY::Binary &binary)     -> TACKY::Value * {return &binary.dst;},
+  [](TACKY::Copy &copy)         -> TACKY::Value * {return &copy.dst;},
+  [](TACKY::SignExtend &extend) -> TACKY::Value * {return &extend.dst;},
+  [](TACKY::ZeroExtend &extend) -> TACKY::Value * {return &extend.dst;},
+  [](TACKY::Truncate &truncate) -> TACKY::Value * {return &truncate.dst;},
+  [](TACKY::FunCall &call)      -> TACKY::Value * {return &call.dst;},
+ }, inst);
+}
+
+// The label a jump goes to, if the instruction is one.
+inline TACKY::Var *get_target(TACKY::Instruction &inst) {
+ return std::visit(overloaded{
+  [](auto &) -> TACKY::Var * {return nullptr;},
+  [](TACKY::Jump &jump)          -> TACKY::Var * {return &jump.target;},
+  [](TACKY::JumpIfZero &jump)    -> TACKY::Var * {return &jump.target;},
+  [](TACKY::JumpIfNotZero &jump) -> TACKY::Var * {return &jump.target;},
+ }, inst);
+}
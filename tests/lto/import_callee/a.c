@@ -0,0 +1,5 @@
+int f(int x);
+
+int main(void) {
+ return f(20);
+}
@@ -0,0 +1,9 @@
+// f is small enough for a.c to import, after which a.c calls g itself, so g
+// must stay exported even though no other module called it before.
+int g(int x) {
+ return x + 1;
+}
+
+int f(int x) {
+ return g(x) * 2;
+}
@@ -0,0 +1,20 @@
+// A conditional's condition has its own type, which can be narrower than
+// the result; so can a loop's.
+long pick(long i) {
+ long y = (!(100)) ? 7 : (i ^ 100);
+ return y;
+}
+
+int count(long n) {
+ int steps = 0;
+ while (n) {
+  n = n / 65536;
+  steps = steps + 1;
+ }
+ return steps;
+}
+
+int main(void) {
+ long big = 4294967296;
+ return (int)pick(5) + count(big) * 3;
+}
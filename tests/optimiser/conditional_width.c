@@ -0,0 +1,27 @@
+// A conditional's arms are converted to its type, a comparison is an int
+// whatever the type of its operands, and && and || test theirs at full width.
+long widen(int g, int small) {
+ long y = g ? small : 4294967296l;
+ return y;
+}
+
+int narrow(int g, long a) {
+ int x = g ? 7 : (a > 2l);
+ return x;
+}
+
+unsigned mixed(int g, long a) {
+ unsigned u = g ? 3u : -1;
+ long z = g ? u : a;
+ return z == 3 ? 5 : (z < 0 ? 9 : 1);
+}
+
+int both(long a, long b) {
+ return (a && b) + (a || b) * 2;
+}
+
+int main(void) {
+ long w = widen(0, -100) / 65536 + widen(1, -100);
+ int n = narrow(0, 100) + narrow(0, 1) * 2 + narrow(1, 0) * 4;
+ return (int)w - 100 + 65536 + n + mixed(1, -8) + mixed(0, -8) * 10 + both(4294967296, 8589934592) * 8;
+}
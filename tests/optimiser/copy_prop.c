@@ -0,0 +1,34 @@
+// copy-prop: a copy only reaches where no path has overwritten its source
+// or destination, and a call can change a static variable.
+static int counter = 0;
+
+int bump(void) {
+ counter = counter + 1;
+ return counter;
+}
+
+int branches(int a, int flag) {
+ int b = a;
+ if (flag) a = a + 10;
+ return b + a;
+}
+
+int loops(int n) {
+ int x = 1;
+ int y = x;
+ for (int i = 0; i < n; i = i + 1) {
+  y = x;
+  x = x * 2;
+ }
+ return y + x;
+}
+
+int statics(void) {
+ int seen = counter;
+ bump();
+ return counter - seen;
+}
+
+int main(void) {
+ return branches(3, 0) + branches(3, 1) * 2 + loops(4) * 3 + statics() * 5;
+}
@@ -0,0 +1,24 @@
+// dse: dead arithmetic and copies go, but a write to a static variable and a
+// call whose result nobody reads still happen.
+static int total = 0;
+
+int add(int x) {
+ total = total + x;
+ return total;
+}
+
+int work(int a) {
+ int dead = a * 100;
+ int overwritten = a + 1;
+ overwritten = a + 2;
+ add(a);
+ add(overwritten);
+ total = total + 1;
+ dead = a - 1;
+ return overwritten;
+}
+
+int main(void) {
+ int r = work(5);
+ return r * 10 + total;
+}
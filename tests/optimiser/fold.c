@@ -0,0 +1,23 @@
+// fold: constant arithmetic wraps at the width of its type, comparisons and
+// division follow signedness, and casts truncate or extend.
+int main(void) {
+ unsigned wrapped = 4294967295u + 2u;
+ long widened = (long)-1 + 4294967296l;
+ int truncated = (int)4294967298l;
+ long unsigned_widened = (long)4294967295u;
+ int mixed = -1 < 1u;
+ int quotient = -7 / 2;
+ int remainder = -7 % 2;
+ int shifted = (-16 >> 2) + (1 << 4);
+ unsigned long big = (unsigned long)-1 / 2;
+
+ if (wrapped != 1) return 1;
+ if (widened != 4294967295l) return 2;
+ if (truncated != 2) return 3;
+ if (unsigned_widened != 4294967295l) return 4;
+ if (mixed) return 5;
+ if (quotient != -3 || remainder != -1) return 6;
+ if (shifted != 12) return 7;
+ if (big != 9223372036854775807l) return 8;
+ return 42;
+}
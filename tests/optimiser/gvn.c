@@ -0,0 +1,35 @@
+// gvn: an expression already computed in a dominating block is reused, but
+// not when it reads a static variable a call may have changed, nor across
+// types.
+static int scale = 3;
+
+int rescale(void) {
+ scale = scale + 1;
+ return scale;
+}
+
+int reuse(int a, int b) {
+ int x = a * b + 1;
+ int y = 0;
+ if (a > 0) y = a * b + 1;
+ else y = (a * b + 1) * 2;
+ return x + y;
+}
+
+int statics(int a) {
+ int x = a * scale;
+ rescale();
+ int y = a * scale;
+ return y - x;
+}
+
+long widths(int a) {
+ long wide = (long)a * 4294967296l;
+ int narrow = a * 2;
+ long again = (long)a * 4294967296l;
+ return (wide - again) + narrow;
+}
+
+int main(void) {
+ return reuse(2, 5) + reuse(-2, 5) + statics(7) * 3 + (int)widths(9);
+}
@@ -0,0 +1,22 @@
+// jump-threading: a branch the earlier comparisons already decide is
+// skipped along those paths, and still taken where they do not.
+int correlated(int x) {
+ int a = 0;
+ if (x > 5) a = 1;
+ else a = 2;
+ if (x > 5) a = a + 10;
+ else if (x == 3) a = a + 20;
+ return a;
+}
+
+int unsigned_range(unsigned u) {
+ int r = 0;
+ if (u < 4u) r = 1;
+ if (u == 4294967295u) r = r + 2;
+ if (u < 4u) r = r + 4;
+ return r;
+}
+
+int main(void) {
+ return correlated(9) + correlated(3) * 2 + correlated(1) * 3 + unsigned_range(4294967295u) * 4 + unsigned_range(2u) * 5;
+}
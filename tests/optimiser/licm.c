@@ -0,0 +1,36 @@
+// licm: invariant arithmetic leaves the loop, but a division that could trap
+// stays where it was, in a loop that never runs.
+int invariant(int a, int b, int n) {
+ int total = 0;
+ for (int i = 0; i < n; i = i + 1) {
+  int k = a * b + 3;
+  total = total + k + i;
+ }
+ return total;
+}
+
+int division(int d, int n) {
+ int total = 0;
+ int i = 0;
+ while (i < n) {
+  int q = 100 / d;
+  int m = (-2147483647 - 1) / -1;
+  total = total + q + m;
+  i = i + 1;
+ }
+ return total;
+}
+
+int last_write(int n) {
+ int x = 5;
+ int i = 0;
+ while (i < n) {
+  if (i == 2) x = n * 7;
+  i = i + 1;
+ }
+ return x;
+}
+
+int main(void) {
+ return invariant(2, 3, 4) + division(0, 0) + last_write(1) + last_write(3) * 2;
+}
@@ -0,0 +1,32 @@
+// Loops: nested loops, a loop with several back edges and one whose header
+// is the function's first block.
+int nested(int n) {
+ int total = 0;
+ for (int i = 0; i < n; i = i + 1) {
+  int base = n * 2;
+  for (int j = 0; j < i; j = j + 1) total = total + base + j;
+ }
+ return total;
+}
+
+int continues(int n) {
+ int total = 0;
+ int i = 0;
+ while (i < n) {
+  i = i + 1;
+  if (i % 3 == 0) continue;
+  total = total + i;
+ }
+ return total;
+}
+
+int from_entry(int n) {
+top:
+ n = n - 3;
+ if (n > 0) goto top;
+ return n;
+}
+
+int main(void) {
+ return nested(4) + continues(10) + from_entry(10) * 5;
+}
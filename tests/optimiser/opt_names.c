@@ -0,0 +1,16 @@
+// The optimiser's own temporaries must not take the names the resolver gives
+// a variable called `opt`.
+int reassociate(int opt, int a, int b) {
+ return ((a + 1) + (b + 2)) + ((a + 3) + opt);
+}
+
+int sum(int opt) {
+ int total = 0;
+ for (int i = 1; i <= opt; i = i + 1) total = total + i;
+ return total;
+}
+
+int main(void) {
+ int opt = 4;
+ return reassociate(opt, 2, 4) + sum(6) + opt;
+}
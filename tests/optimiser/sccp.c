@@ -0,0 +1,26 @@
+// sccp: a variable that keeps its value around a loop is a constant, and the
+// branches on it go one way; one the loop does change is not.
+int steady(int n) {
+ int x = 1;
+ int i = 0;
+ while (i < n) {
+  if (x != 1) x = 2;
+  i = i + 1;
+ }
+ return x;
+}
+
+int changing(int n) {
+ int x = 1;
+ int i = 0;
+ while (i < n) {
+  if (x != 1) x = x + 10;
+  else x = 3;
+  i = i + 1;
+ }
+ return x;
+}
+
+int main(void) {
+ return steady(5) + changing(0) * 2 + changing(1) * 4 + changing(3) * 8;
+}
@@ -0,0 +1,25 @@
+// simplify: identities and reassociated chains keep the width and
+// signedness of the original expression.
+long not_not(long x) {
+ return !!x;
+}
+
+int shifts(int x) {
+ return x * 8 + x * -4;
+}
+
+unsigned chain(unsigned a, unsigned b) {
+ return (a + 4294967295u) + (b + 3u) + 2u;
+}
+
+int same(int x, long y) {
+ return (x - x) + (x & -1) + (int)(y ^ y) + (x | 0);
+}
+
+int main(void) {
+ if (not_not(4294967296l) != 1) return 1;
+ if (shifts(-3) != -12) return 2;
+ if (chain(1u, 4294967295u) != 4u) return 3;
+ if (same(-5, 9l) != -10) return 4;
+ return 17;
+}
@@ -0,0 +1,29 @@
+// simplify-cfg: chains of jumps, a loop made only of jumps and code nothing
+// reaches are removed without changing where control goes.
+int chain(int x) {
+ goto a;
+ x = x + 100;
+c:
+ goto d;
+a:
+ goto b;
+b:
+ if (x > 0) goto c;
+ return x - 1;
+d:
+ return x + 1;
+}
+
+int spin(int x) {
+ if (x > 100) {
+ top:
+  goto bottom;
+ bottom:
+  goto top;
+ }
+ return x * 2;
+}
+
+int main(void) {
+ return chain(4) + chain(-4) * 3 + spin(7);
+}
@@ -0,0 +1,26 @@
+// SSA: variables that swap around a loop and a value live out of the loop
+// it is overwritten in come back out of phis in the right order.
+int swap(int n) {
+ int a = 1;
+ int b = 2;
+ for (int i = 0; i < n; i = i + 1) {
+  int t = a;
+  a = b;
+  b = t;
+ }
+ return a * 10 + b;
+}
+
+int lost_copy(int n) {
+ int x = 1;
+ int y = 0;
+ do {
+  y = x;
+  x = x + 1;
+ } while (x < n);
+ return y;
+}
+
+int main(void) {
+ return swap(3) + swap(4) + lost_copy(5) * 4;
+}
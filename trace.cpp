@@ -0,0 +1,111 @@
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "trace.h"
+
+struct TraceEvent {
+ const char *name;
+ std::string detail;
+ int64_t start, duration;
+};
+
+struct OpenSpan {
+ const char *name;
+ bool phase;
+ size_t event;
+};
+
+bool Trace::enabled = false;
+
+static bool recording = false;
+static std::vector<TraceEvent> events;
+static std::vector<OpenSpan> open_spans;
+static std::vector<Trace::Observer *> observers;
+static std::string trace_path;
+static std::chrono::steady_clock::time_point origin;
+
+static int64_t now() {
+ return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+static std::string escape(const std::string &str) {
+ std::string out;
+ for (char c : str) {
+  if (c == '"' || c == '\\') {
+   out += '\\';
+   out += c;
+  } else if ((unsigned char)c < 0x20) {
+   char buf[8];
+   snprintf(buf, sizeof(buf), "\\u%04x", c);
+   out += buf;
+  } else out += c;
+ }
+
+ return out;
+}
+
+// Spans still open (e.g. after error() exits) are closed at the time of
+// writing.
+static void write_trace() {
+ while (!open_spans.empty()) Trace::pop();
+
+ FILE *file = fopen(trace_path.c_str(), "w");
+ if (file == nullptr) return;
+
+ fprintf(file, "{\"traceEvents\":[\n");
+ for (size_t i = 0; i < events.size(); i++) {
+  TraceEvent &event = events[i];
+  fprintf(file,
+   "{\"name\":\"%s\",\"cat\":\"compiler\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1",
+   escape(event.name).c_str(), event.start / 1000.0, event.duration / 1000.0
+  );
+
+  if (event.detail != "") fprintf(file, ",\"args\":{\"detail\":\"%s\"}", escape(event.detail).c_str());
+  fprintf(file, i + 1 < events.size() ? "},\n" : "}\n");
+ }
+ fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+ fclose(file);
+}
+
+void Trace::start(std::string path) {
+ if (recording) return;
+
+ enabled = recording = true;
+ trace_path = path;
+ origin = std::chrono::steady_clock::now();
+ atexit(write_trace);
+}
+
+void Trace::observe(Observer *observer) {
+ enabled = true;
+ observers.push_back(observer);
+}
+
+void Trace::push(const char *name, bool phase, const char *detail, size_t length) {
+ open_spans.push_back({name, phase, events.size()});
+ if (phase) {
+  for (Observer *observer : observers) observer->phase_begin(name);
+ }
+
+ if (recording) events.push_back({name, detail ? std::string(detail, length) : "", now(), 0});
+}
+
+void Trace::pop(const char *detail, size_t length) {
+ if (open_spans.empty()) return;
+
+ OpenSpan span = open_spans.back();
+ open_spans.pop_back();
+
+ if (recording) {
+  TraceEvent &event = events[span.event];
+  event.duration = now() - event.start;
+  if (detail != nullptr) event.detail.assign(detail, length);
+ }
+
+ if (span.phase) {
+  for (size_t i = observers.size(); i-- > 0;) observers[i]->phase_end(span.name);
+ }
+}
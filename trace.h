@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include "lexer/tokens.h"
+
+// Phase and per-item spans for the profiling flags. -ftime-trace records all
+// of them as Chrome trace events (nesting by time, so the per-function spans
+// of a phase show up underneath it); observers such as -fmem-report are only
+// told about phases. While nothing is profiling a span costs one branch on
+// `enabled`, and details are only computed when it is on.
+namespace Trace {
+ extern bool enabled;
+
+ // Measures something across each phase.
+ struct Observer {
+  virtual void phase_begin(const char *name) = 0;
+  virtual void phase_end(const char *name) = 0;
+ };
+
+ void start(std::string path);
+ void observe(Observer *observer);
+ void push(const char *name, bool phase, const char *detail = nullptr, size_t length = 0);
+ void pop(const char *detail = nullptr, size_t length = 0);
+
+ inline void begin(const char *name) {
+  if (enabled) push(name, true);
+ }
+
+ inline void end() {
+  if (enabled) pop();
+ }
+
+ // An item span whose detail (a Token) is only known at its end.
+ inline void begin_item(const char *name) {
+  if (enabled) push(name, false);
+ }
+
+ template<class F>
+ inline void end(F detail) {
+  if (enabled) {
+   Token token = detail();
+   pop(token.start, token.length);
+  }
+ }
+
+ class Scope {
+  private:
+   bool active;
+
+  public:
+   Scope(const char *name) : active(enabled) {
+    if (active) push(name, true);
+   }
+
+   // A span for one item of a phase, such as a function.
+   template<class F>
+   Scope(const char *name, F detail) : active(enabled) {
+    if (active) {
+     Token token = detail();
+     push(name, false, token.start, token.length);
+    }
+   }
+
+   ~Scope() {
+    if (active) pop();
+   }
+ };
+}